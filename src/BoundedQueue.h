@@ -0,0 +1,100 @@
+//
+// The MIT License (MIT)
+//
+// Copyright 2020 Karolpg
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), 
+// to deal in the Software without restriction, including without limitation the rights to #use, copy, modify, merge, publish, distribute, sublicense, 
+// and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR #COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, 
+// WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+
+#pragma once
+
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+#include <algorithm>
+
+///
+/// \brief The BoundedQueue class - blocking FIFO connecting pipeline stages. Producer waits when queue is full,
+///                                so faster stage can't run away from slower one.
+///
+template<typename T>
+class BoundedQueue
+{
+public:
+    explicit BoundedQueue(size_t capacity)
+        : m_capacity(std::max<size_t>(1, capacity))
+    {
+    }
+
+    ///
+    /// \brief push - waits while queue is full
+    /// \return false - queue is closed, item is not added
+    ///
+    bool push(T&& item)
+    {
+        {
+            std::unique_lock<std::mutex> ul(m_mutex);
+            m_notFull.wait(ul, [this] { return m_closed || m_items.size() < m_capacity; });
+            if (m_closed) {
+                return false;
+            }
+            m_items.push_back(std::move(item));
+        }
+        m_notEmpty.notify_one();
+        return true;
+    }
+
+    ///
+    /// \brief pop - waits while queue is empty
+    /// \return false - queue is closed
+    ///
+    bool pop(T& item)
+    {
+        {
+            std::unique_lock<std::mutex> ul(m_mutex);
+            m_notEmpty.wait(ul, [this] { return m_closed || !m_items.empty(); });
+            if (m_closed) {
+                return false;
+            }
+            item = std::move(m_items.front());
+            m_items.pop_front();
+        }
+        m_notFull.notify_one();
+        return true;
+    }
+
+    ///
+    /// \brief close - wakes up all waiting threads, next push and pop fail
+    ///
+    void close()
+    {
+        {
+            const std::lock_guard<std::mutex> lg(m_mutex);
+            m_closed = true;
+        }
+        m_notEmpty.notify_all();
+        m_notFull.notify_all();
+    }
+
+    size_t size() const
+    {
+        const std::lock_guard<std::mutex> lg(m_mutex);
+        return m_items.size();
+    }
+
+private:
+    const size_t m_capacity;
+    mutable std::mutex m_mutex;
+    std::condition_variable m_notEmpty;
+    std::condition_variable m_notFull;
+    std::deque<T> m_items;
+    bool m_closed = false;
+};
@@ -0,0 +1,105 @@
+//
+// The MIT License (MIT)
+//
+// Copyright 2020 Karolpg
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), 
+// to deal in the Software without restriction, including without limitation the rights to #use, copy, modify, merge, publish, distribute, sublicense, 
+// and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR #COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, 
+// WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+
+
+#include "BoxUtils.h"
+#include <algorithm>
+
+namespace BoxUtils {
+
+float left(const DetectionBox& b)   { return b.x - b.w / 2.0f; }
+float right(const DetectionBox& b)  { return b.x + b.w / 2.0f; }
+float top(const DetectionBox& b)    { return b.y - b.h / 2.0f; }
+float bottom(const DetectionBox& b) { return b.y + b.h / 2.0f; }
+float area(const DetectionBox& b)   { return b.w * b.h; }
+
+DetectionBox fromEdges(float left, float top, float right, float bottom)
+{
+    return {(left + right) / 2.0f, (top + bottom) / 2.0f, right - left, bottom - top};
+}
+
+float intersection(const DetectionBox& a, const DetectionBox& b)
+{
+    float w = std::min(right(a), right(b)) - std::max(left(a), left(b));
+    float h = std::min(bottom(a), bottom(b)) - std::max(top(a), top(b));
+    if (w <= 0.0f || h <= 0.0f) {
+        return 0.0f;
+    }
+    return w * h;
+}
+
+float iou(const DetectionBox& a, const DetectionBox& b)
+{
+    float i = intersection(a, b);
+    float u = area(a) + area(b) - i;
+    return u > 0.0f ? i / u : 0.0f;
+}
+
+DetectionBox unite(const DetectionBox& a, const DetectionBox& b)
+{
+    return fromEdges(std::min(left(a), left(b)), std::min(top(a), top(b)),
+                     std::max(right(a), right(b)), std::max(bottom(a), bottom(b)));
+}
+
+bool touch(const DetectionBox& a, const DetectionBox& b, float marginX, float marginY)
+{
+    float gapX = std::max(left(a), left(b)) - std::min(right(a), right(b));
+    float gapY = std::max(top(a), top(b)) - std::min(bottom(a), bottom(b));
+    return gapX <= marginX && gapY <= marginY;
+}
+
+void mergeTouching(std::vector<DetectionBox>& boxes, float marginX, float marginY)
+{
+    bool merged = true;
+    while (merged) { // merged box can touch another one, so repeat until nothing changes
+        merged = false;
+        for (size_t i = 0; i < boxes.size(); ++i) {
+            for (size_t j = i + 1; j < boxes.size();) {
+                if (touch(boxes[i], boxes[j], marginX, marginY)) {
+                    boxes[i] = unite(boxes[i], boxes[j]);
+                    boxes.erase(boxes.begin() + static_cast<long>(j));
+                    merged = true;
+                }
+                else {
+                    ++j;
+                }
+            }
+        }
+    }
+}
+
+void mergeOverlapping(std::vector<DetectionBox>& boxes, float minOverlap)
+{
+    bool merged = true;
+    while (merged) {
+        merged = false;
+        for (size_t i = 0; i < boxes.size(); ++i) {
+            for (size_t j = i + 1; j < boxes.size();) {
+                float smallerArea = std::min(area(boxes[i]), area(boxes[j]));
+                if (smallerArea > 0.0f && intersection(boxes[i], boxes[j]) >= minOverlap * smallerArea) {
+                    boxes[i] = unite(boxes[i], boxes[j]);
+                    boxes.erase(boxes.begin() + static_cast<long>(j));
+                    merged = true;
+                }
+                else {
+                    ++j;
+                }
+            }
+        }
+    }
+}
+
+} // namespace BoxUtils
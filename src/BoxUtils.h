@@ -0,0 +1,59 @@
+//
+// The MIT License (MIT)
+//
+// Copyright 2020 Karolpg
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), 
+// to deal in the Software without restriction, including without limitation the rights to #use, copy, modify, merge, publish, distribute, sublicense, 
+// and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR #COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, 
+// WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+
+
+#pragma once
+
+#include <vector>
+
+///
+/// Box in relative coordinates <0, 1> of the image, (x, y) is the box center - the same convention as darknet uses.
+///
+struct DetectionBox
+{
+    float x, y, w, h;
+};
+
+namespace BoxUtils {
+
+float left(const DetectionBox& b);
+float right(const DetectionBox& b);
+float top(const DetectionBox& b);
+float bottom(const DetectionBox& b);
+float area(const DetectionBox& b);
+
+DetectionBox fromEdges(float left, float top, float right, float bottom);
+
+float intersection(const DetectionBox& a, const DetectionBox& b);
+float iou(const DetectionBox& a, const DetectionBox& b);
+
+/// smallest box containing both
+DetectionBox unite(const DetectionBox& a, const DetectionBox& b);
+
+/// \param margin - boxes are treated as touching when gap between them is not bigger than margin (relative)
+bool touch(const DetectionBox& a, const DetectionBox& b, float marginX, float marginY);
+
+///
+/// \brief mergeTouching - replaces every group of touching boxes with one box containing them
+///
+void mergeTouching(std::vector<DetectionBox>& boxes, float marginX, float marginY);
+
+///
+/// \brief mergeOverlapping - replaces boxes which cover at least minOverlap part of the smaller one with box containing them
+///
+void mergeOverlapping(std::vector<DetectionBox>& boxes, float minOverlap);
+
+} // namespace BoxUtils
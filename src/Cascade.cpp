@@ -0,0 +1,91 @@
+//
+// The MIT License (MIT)
+//
+// Copyright 2020 Karolpg
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), 
+// to deal in the Software without restriction, including without limitation the rights to #use, copy, modify, merge, publish, distribute, sublicense, 
+// and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR #COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, 
+// WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+
+#include "Cascade.h"
+
+#include <sstream>
+#include <iostream>
+
+namespace {
+
+Config secondStageConfig(const Config& cfg)
+{
+    Config config = cfg.withPrefix("cascade");
+    // second stage checks only crops around first stage results
+    if (!cfg.hasKey("cascadeDetectorTiling")) {
+        config.setValue("detectorTiling", "0");
+    }
+    if (!cfg.hasKey("cascadeDetectorCropRegions")) {
+        config.setValue("detectorCropRegions", "1");
+    }
+    return config;
+}
+
+uint64_t microseconds(double seconds)
+{
+    return static_cast<uint64_t>(seconds * 1e6);
+}
+
+} // namespace
+
+Cascade::Cascade(const Config& cfg)
+    : m_config(secondStageConfig(cfg))
+    , m_batcher(std::make_shared<InferenceBatcher>(m_config))
+    , m_acceptThreshold(cfg.getValue("cascadeAcceptThreshold", 0.6f))
+    , m_confirmIou(cfg.getValue("cascadeConfirmIou", 0.3f))
+{
+    std::istringstream classes(cfg.getValue("cascadeClasses"));
+    std::string label;
+    while (classes >> label) {
+        m_classes.insert(label);
+    }
+    std::cout << "Cascade: second stage " << m_config.getValue("darknetCfgFilePath") << (isValid() ? "" : " not loaded") << "\n";
+}
+
+bool Cascade::needsConfirmation(const std::string& label, float probability) const
+{
+    return probability < m_acceptThreshold || m_classes.count(label) > 0;
+}
+
+void Cascade::addFirstStage(uint64_t accepted, uint64_t candidates, double time)
+{
+    ++m_frames;
+    m_accepted += accepted;
+    m_candidates += candidates;
+    m_firstStageTime += microseconds(time);
+}
+
+void Cascade::addSecondStage(uint64_t confirmed, uint64_t rejected, double time)
+{
+    ++m_confirmations;
+    m_confirmed += confirmed;
+    m_rejected += rejected;
+    m_secondStageTime += microseconds(time);
+}
+
+Cascade::Metrics Cascade::getMetrics() const
+{
+    Metrics metrics;
+    metrics.frames = m_frames;
+    metrics.candidates = m_candidates;
+    metrics.accepted = m_accepted;
+    metrics.confirmed = m_confirmed;
+    metrics.rejected = m_rejected;
+    metrics.confirmations = m_confirmations;
+    metrics.firstStageTime = m_firstStageTime / 1e6;
+    metrics.secondStageTime = m_secondStageTime / 1e6;
+    return metrics;
+}
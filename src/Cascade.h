@@ -0,0 +1,76 @@
+//
+// The MIT License (MIT)
+//
+// Copyright 2020 Karolpg
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), 
+// to deal in the Software without restriction, including without limitation the rights to #use, copy, modify, merge, publish, distribute, sublicense, 
+// and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR #COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, 
+// WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+
+#pragma once
+
+#include <set>
+#include <string>
+#include <memory>
+#include <atomic>
+#include <cstdint>
+#include "Config.h"
+#include "InferenceBatcher.h"
+
+///
+/// \brief The Cascade class - second, heavier detection stage shared by detectors. The first (fast) network runs on every
+///                           trigger, its results which are not probable enough or are of chosen classes are confirmed
+///                           by the second network run on crops around them. Second stage config is the main one
+///                           overridden by keys with "cascade" prefix, e.g. cascadeDarknetCfgFilePath, cascadeProbabilityThreshold.
+///                           Both networks have to use the same labels.
+///
+class Cascade
+{
+public:
+    struct Metrics {
+        uint64_t frames = 0;      // first stage runs
+        uint64_t candidates = 0;  // first stage results sent to confirmation
+        uint64_t accepted = 0;    // first stage results accepted without confirmation
+        uint64_t confirmed = 0;
+        uint64_t rejected = 0;
+        uint64_t confirmations = 0; // second stage runs
+        double firstStageTime = 0.0;  // [s] total
+        double secondStageTime = 0.0; // [s] total
+    };
+
+    Cascade(const Config& cfg);
+
+    bool isValid() const { return m_batcher->isValid(); }
+    const Config& config() const { return m_config; } // of second stage
+    const std::shared_ptr<InferenceBatcher>& batcher() const { return m_batcher; }
+
+    bool needsConfirmation(const std::string& label, float probability) const;
+    float confirmIou() const { return m_confirmIou; }
+
+    void addFirstStage(uint64_t accepted, uint64_t candidates, double time);
+    void addSecondStage(uint64_t confirmed, uint64_t rejected, double time);
+    Metrics getMetrics() const;
+
+private:
+    Config m_config;
+    std::shared_ptr<InferenceBatcher> m_batcher;
+    float m_acceptThreshold; // first stage results at least that probable are accepted
+    std::set<std::string> m_classes; // always confirmed
+    float m_confirmIou;      // second stage box of the same class has to overlap that much
+
+    std::atomic<uint64_t> m_frames{0};
+    std::atomic<uint64_t> m_candidates{0};
+    std::atomic<uint64_t> m_accepted{0};
+    std::atomic<uint64_t> m_confirmed{0};
+    std::atomic<uint64_t> m_rejected{0};
+    std::atomic<uint64_t> m_confirmations{0};
+    std::atomic<uint64_t> m_firstStageTime{0};  // [us]
+    std::atomic<uint64_t> m_secondStageTime{0}; // [us]
+};
@@ -16,6 +16,8 @@
 
 #include "ColorGenerator.h"
 
+#include <algorithm>
+
 std::vector<uint32_t> ColorGenerator::generateColorsRGB(uint32_t count) {
     std::vector<uint32_t> result(count);
     uint32_t SINGLE_PHASE_VALUES = (MAX_VALUE - START_VALUE) / STEP_VISIBLE_FOR_EYE;
@@ -339,3 +341,24 @@ std::vector<uint32_t> ColorGenerator::generateColorsRGB(uint32_t count) {
     }
     return result;
 }
+
+std::vector<uint32_t> ColorGenerator::generateHeatColorsRGB(uint32_t count) {
+    std::vector<uint32_t> result(count);
+    for (uint32_t i = 0; i < count; ++i) {
+        // position on path blue -> cyan -> green -> yellow -> red, 4 segments of MAX_VALUE steps
+        uint32_t pos = count > 1 ? i * 4 * MAX_VALUE / (count - 1) : 4 * MAX_VALUE;
+        uint32_t segment = std::min(pos / MAX_VALUE, 3u);
+        uint32_t value = pos - segment * MAX_VALUE;
+        uint32_t r = 0;
+        uint32_t g = 0;
+        uint32_t b = 0;
+        switch (segment) {
+            case 0: g = value;             b = MAX_VALUE;         break;
+            case 1: g = MAX_VALUE;         b = MAX_VALUE - value; break;
+            case 2: r = value;             g = MAX_VALUE;         break;
+            default: r = MAX_VALUE;        g = MAX_VALUE - value; break;
+        }
+        result[i] = 0xff000000u | (b << 16) | (g << 8) | r;
+    }
+    return result;
+}
@@ -22,6 +22,8 @@ class ColorGenerator
 public:
     //Alpha set to 255
     static std::vector<uint32_t> generateColorsRGB(uint32_t count);
+    //Alpha set to 255, ordered from cold to hot: blue, cyan, green, yellow, red
+    static std::vector<uint32_t> generateHeatColorsRGB(uint32_t count);
 private:
     static const uint8_t STEP_VISIBLE_FOR_EYE = 7;
     static const uint8_t START_VALUE = 100;
@@ -18,6 +18,7 @@
 
 #include <fstream>
 #include <iostream>
+#include <cctype>
 
 const std::string &Config::getValue(const std::string &key, const std::string &defaultVal) const
 {
@@ -88,3 +89,17 @@ bool Config::insertFromFile(const std::string& filePath)
     }
     return true;
 }
+
+Config Config::withPrefix(const std::string& prefix) const
+{
+    Config result(*this);
+    for (const auto& keyValue : m_keyValues) {
+        const std::string& key = keyValue.first;
+        if (key.size() > prefix.size() && key.compare(0, prefix.size(), prefix) == 0) {
+            std::string overridden = key.substr(prefix.size());
+            overridden[0] = static_cast<char>(std::tolower(static_cast<unsigned char>(overridden[0])));
+            result.setValue(overridden, keyValue.second);
+        }
+    }
+    return result;
+}
@@ -52,6 +52,12 @@ public:
     bool hasKey(const std::string& key) const;
 
     bool insertFromFile(const std::string& filePath);
+
+    ///
+    /// \brief withPrefix - copy where values of keys starting with prefix override keys without it,
+    ///                     e.g. for prefix "cascade": cascadeDarknetCfgFilePath -> darknetCfgFilePath
+    ///
+    Config withPrefix(const std::string& prefix) const;
 private:
     std::map<std::string, std::string> m_keyValues;
 };
@@ -17,6 +17,7 @@
 #pragma once
 
 #include <functional>
+#include <vector>
 
 namespace CppTools {
 
@@ -27,4 +28,17 @@ void* functionAddress(std::function<T(U...)> f) {
     return reinterpret_cast<void*>(*fnPtr);
 }
 
+///
+/// \brief fitBuffer - resizes buffer kept between calls. Memory left by much bigger earlier use is released,
+///                    so one large frame doesn't hold its buffers for the rest of process life.
+///
+template<typename T>
+void fitBuffer(std::vector<T>& buffer, size_t size)
+{
+    buffer.resize(size);
+    if (buffer.capacity() > 2*size) {
+        buffer.shrink_to_fit();
+    }
+}
+
 } // namespace CppTools
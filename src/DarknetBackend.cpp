@@ -0,0 +1,336 @@
+//
+// The MIT License (MIT)
+//
+// Copyright 2020 Karolpg
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), 
+// to deal in the Software without restriction, including without limitation the rights to #use, copy, modify, merge, publish, distribute, sublicense, 
+// and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR #COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, 
+// WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+
+#include "DarknetBackend.h"
+
+#include <darknet.h>
+#include <iostream>
+#include <mutex>
+#include <cstring>
+#include <cmath>
+#include <vector>
+#include <assert.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+namespace {
+
+///
+/// \brief The MappedWeights class - read only view of weights file mapped into memory.
+///                                  Pages are read ahead sequentially, instances loading the same file share them.
+///
+class MappedWeights
+{
+public:
+    explicit MappedWeights(const std::string& filePath)
+    {
+        int fd = open(filePath.c_str(), O_RDONLY);
+        if (fd < 0) {
+            return;
+        }
+        struct stat st;
+        if (fstat(fd, &st) == 0 && st.st_size > 0) {
+            void* data = mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_PRIVATE | MAP_POPULATE, fd, 0);
+            if (data != MAP_FAILED) {
+                madvise(data, static_cast<size_t>(st.st_size), MADV_SEQUENTIAL);
+                m_data = static_cast<const char*>(data);
+                m_size = static_cast<size_t>(st.st_size);
+            }
+        }
+        close(fd);
+    }
+    ~MappedWeights()
+    {
+        if (m_data) {
+            munmap(const_cast<char*>(m_data), m_size);
+        }
+    }
+    MappedWeights(const MappedWeights&) = delete;
+    MappedWeights& operator=(const MappedWeights&) = delete;
+
+    bool isValid() const { return m_data != nullptr; }
+
+    template<typename T>
+    bool read(T* dst, size_t count)
+    {
+        const size_t bytes = count * sizeof(T);
+        if (m_size - m_pos < bytes) {
+            return false;
+        }
+        std::memcpy(dst, m_data + m_pos, bytes);
+        m_pos += bytes;
+        return true;
+    }
+
+private:
+    const char* m_data = nullptr;
+    size_t m_size = 0;
+    size_t m_pos = 0;
+};
+
+///
+/// \brief loadMappedWeights - fills layers in the same way as darknet load_weights but copies straight from mapped file.
+///                            Only layer types used by detection networks are handled (convolutional, connected, batchnorm),
+///                            for others (recurrent, local, binary, transposed) false is returned and darknet reader has to be used.
+///
+bool loadMappedWeights(network* net, const std::string& filePath)
+{
+#if defined(GPU) && GPU > 0
+    (void)net;
+    (void)filePath;
+    return false; // darknet reader pushes weights to device
+#else
+    for (int i = 0; i < net->n; ++i) {
+        const layer& l = net->layers[i];
+        bool supported = l.type == CONVOLUTIONAL || l.type == CONNECTED || l.type == BATCHNORM;
+        bool hasWeights = supported || l.type == DECONVOLUTIONAL || l.type == LOCAL || l.type == RNN || l.type == GRU || l.type == LSTM || l.type == CRNN;
+        if (!l.dontload && hasWeights && (!supported || l.binary || l.flipped || l.numload)) {
+            return false;
+        }
+    }
+
+    MappedWeights file(filePath);
+    if (!file.isValid()) {
+        return false;
+    }
+    int major = 0, minor = 0, revision = 0;
+    if (!file.read(&major, 1) || !file.read(&minor, 1) || !file.read(&revision, 1)) {
+        return false;
+    }
+    if (major > 1000 || minor > 1000) {
+        return false; // transposed connected layers
+    }
+    if (major * 10 + minor >= 2) {
+        size_t seen = 0;
+        if (!file.read(&seen, 1)) {
+            return false;
+        }
+        *net->seen = seen;
+    }
+    else {
+        int seen = 0;
+        if (!file.read(&seen, 1)) {
+            return false;
+        }
+        *net->seen = static_cast<size_t>(seen);
+    }
+
+    for (int i = 0; i < net->n; ++i) {
+        layer& l = net->layers[i];
+        if (l.dontload) {
+            continue;
+        }
+        bool ok = true;
+        if (l.type == CONVOLUTIONAL) {
+            const size_t n = static_cast<size_t>(l.n);
+            ok = file.read(l.biases, n);
+            if (ok && l.batch_normalize && !l.dontloadscales) {
+                ok = file.read(l.scales, n) && file.read(l.rolling_mean, n) && file.read(l.rolling_variance, n);
+            }
+            ok = ok && file.read(l.weights, static_cast<size_t>(l.c / l.groups) * n * static_cast<size_t>(l.size * l.size));
+        }
+        else if (l.type == CONNECTED) {
+            const size_t outputs = static_cast<size_t>(l.outputs);
+            ok = file.read(l.biases, outputs) && file.read(l.weights, outputs * static_cast<size_t>(l.inputs));
+            if (ok && l.batch_normalize && !l.dontloadscales) {
+                ok = file.read(l.scales, outputs) && file.read(l.rolling_mean, outputs) && file.read(l.rolling_variance, outputs);
+            }
+        }
+        else if (l.type == BATCHNORM) {
+            const size_t c = static_cast<size_t>(l.c);
+            ok = file.read(l.scales, c) && file.read(l.rolling_mean, c) && file.read(l.rolling_variance, c);
+        }
+        if (!ok) {
+            return false; // file is shorter than network
+        }
+    }
+    return true;
+#endif // defined(GPU) && GPU > 0
+}
+
+} // namespace
+
+DarknetBackend::DarknetBackend(const Config& cfg, uint32_t maxBatch)
+{
+    const std::string& netConfigFilePath = cfg.getValue("darknetCfgFilePath");
+    const std::string& weightsFilePath   = cfg.getValue("darknetWeightsFilePath");
+
+    // process wide darknet state, instances are loaded in parallel
+    static std::once_flag deviceFlag;
+    std::call_once(deviceFlag, [&cfg] () {
+#if defined(GPU) && GPU > 0
+        std::cout << "Detector is running with GPU\n";
+        gpu_index = cfg.getValue("detector_gpu_idx", 0);
+        #if defined(OCL) && OCL > 0
+            cl_set_device(gpu_index);
+        #endif // defined(OCL) && OCL > 0
+#else
+        (void)cfg;
+        std::cout << "Detector is NOT running with GPU\n";
+#endif // defined(GPU) && GPU > 0
+        srand(2222222);
+    });
+
+    // I have no idea why someone assumed to provide file path as non const pointer!?
+    m_net = parse_network_cfg(const_cast<char*>(netConfigFilePath.c_str()));
+    if (!m_net) {
+        std::cerr << "Can't load neural network with cfg file: " << netConfigFilePath << ", weights file: " << weightsFilePath << "\n";
+        return;
+    }
+    if (!weightsFilePath.empty() && !loadMappedWeights(m_net, weightsFilePath)) {
+        load_weights(m_net, const_cast<char*>(weightsFilePath.c_str()));
+    }
+    if (maxBatch > 1) {
+        // layers keep buffers for batch given in cfg file - resizing reallocates them for the new batch size
+        set_batch_network(m_net, static_cast<int>(maxBatch));
+        resize_network(m_net, m_net->w, m_net->h);
+
+        // every instance is the same network - one check is enough
+        static std::once_flag batchCheckFlag;
+        std::call_once(batchCheckFlag, [this] () {
+            if (!checkBatch()) {
+                std::cout << "[WARNING] Darknet gives other detections for batch item than for the same input alone.\n";
+            }
+        });
+    }
+    set_batch_network(m_net, 1);
+    assert(m_net->w * m_net->h * m_net->c > 0);
+}
+
+DarknetBackend::~DarknetBackend()
+{
+    if (m_net) {
+        free_network(m_net);
+    }
+}
+
+bool DarknetBackend::checkBatch()
+{
+    // two different, not mirrored inputs - batch item has to see only its own input
+    const size_t inputSize = this->inputSize();
+    std::vector<float> inputs(2 * inputSize);
+    for (size_t i = 0; i < inputs.size(); ++i) {
+        inputs[i] = static_cast<float>((i * 2654435761u) % 251u) / 250.0f;
+    }
+
+    auto same = [] (const Detections& a, const Detections& b) {
+        const float eps = 1e-3f;
+        if (a.boxes.size() != b.boxes.size() || a.probabilities.size() != b.probabilities.size()) {
+            return false;
+        }
+        for (size_t i = 0; i < a.boxes.size(); ++i) {
+            const DetectionBox& ba = a.boxes[i];
+            const DetectionBox& bb = b.boxes[i];
+            if (std::fabs(ba.x - bb.x) > eps || std::fabs(ba.y - bb.y) > eps || std::fabs(ba.w - bb.w) > eps || std::fabs(ba.h - bb.h) > eps) {
+                return false;
+            }
+        }
+        for (size_t i = 0; i < a.probabilities.size(); ++i) {
+            if (std::fabs(a.probabilities[i] - b.probabilities[i]) > eps) {
+                return false;
+            }
+        }
+        return true;
+    };
+
+    // every box is compared, not only ones above threshold
+    Detections batched[2];
+    predict(inputs.data(), 2);
+    detections(0, 0.0f, 0.0f, batched[0]);
+    detections(1, 0.0f, 0.0f, batched[1]);
+
+    Detections single;
+    for (uint32_t b = 0; b < 2; ++b) {
+        predict(inputs.data() + b * inputSize, 1);
+        detections(0, 0.0f, 0.0f, single);
+        if (!same(single, batched[b])) {
+            return false;
+        }
+    }
+    return true;
+}
+
+uint32_t DarknetBackend::width() const
+{
+    return static_cast<uint32_t>(m_net->w);
+}
+
+uint32_t DarknetBackend::height() const
+{
+    return static_cast<uint32_t>(m_net->h);
+}
+
+uint32_t DarknetBackend::channels() const
+{
+    return static_cast<uint32_t>(m_net->c);
+}
+
+uint32_t DarknetBackend::classes() const
+{
+    return static_cast<uint32_t>(m_net->layers[m_net->n-1].classes);
+}
+
+void DarknetBackend::predict(const float* inputs, uint32_t count)
+{
+    set_batch_network(m_net, static_cast<int>(count));
+    network_predict(m_net, const_cast<float*>(inputs));
+}
+
+void DarknetBackend::detections(uint32_t batchIdx, float threshold, float nmsIou, Detections& out)
+{
+    // darknet reads boxes only from the first batch item - point output layers to the wanted one.
+    // Batch of 2 is taken by darknet as test time flip: output of item 0 is overwritten with average of it
+    // and mirrored next item, so output layers see batch of 1 while boxes are read.
+    for (int l = 0; l < m_net->n; ++l) {
+        layer& lay = m_net->layers[l];
+        if (lay.type == YOLO || lay.type == REGION || lay.type == DETECTION) {
+            lay.output += static_cast<size_t>(batchIdx) * static_cast<size_t>(lay.outputs);
+            lay.batch = 1;
+        }
+    }
+
+    int nboxes = 0;
+    float hier = 0.5f;
+    int *map = nullptr;
+    int relative = 1;
+    detection *dets = get_network_boxes(m_net, m_net->w, m_net->h, threshold, hier, map, relative, &nboxes);
+
+    for (int l = 0; l < m_net->n; ++l) {
+        layer& lay = m_net->layers[l];
+        if (lay.type == YOLO || lay.type == REGION || lay.type == DETECTION) {
+            lay.output -= static_cast<size_t>(batchIdx) * static_cast<size_t>(lay.outputs);
+            lay.batch = m_net->batch; // set_batch_network() gives every layer the network batch
+        }
+    }
+
+    const int classesCount = static_cast<int>(classes());
+    if (nmsIou > 0.0f && nboxes > 0) {
+        // suppressed boxes get zero probability
+        do_nms_sort(dets, nboxes, classesCount, nmsIou);
+    }
+
+    out.boxes.clear();
+    out.probabilities.clear();
+    for (int i = 0; i < nboxes; ++i) {
+        const box& b = dets[i].bbox;
+        out.boxes.push_back({b.x, b.y, b.w, b.h});
+        out.probabilities.insert(out.probabilities.end(), dets[i].prob, dets[i].prob + classesCount);
+    }
+
+    free_detections(dets, nboxes);
+}
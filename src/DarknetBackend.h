@@ -0,0 +1,50 @@
+//
+// The MIT License (MIT)
+//
+// Copyright 2020 Karolpg
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), 
+// to deal in the Software without restriction, including without limitation the rights to #use, copy, modify, merge, publish, distribute, sublicense, 
+// and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR #COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, 
+// WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+
+#pragma once
+
+#include "InferenceBackend.h"
+
+struct network;
+
+///
+/// \brief The DarknetBackend class - darknet network loaded from "darknetCfgFilePath" and "darknetWeightsFilePath".
+///
+class DarknetBackend : public InferenceBackend
+{
+public:
+    DarknetBackend(const Config& cfg, uint32_t maxBatch);
+    ~DarknetBackend() override;
+
+    bool isValid() const { return m_net != nullptr; }
+
+    uint32_t width() const override;
+    uint32_t height() const override;
+    uint32_t channels() const override;
+    uint32_t classes() const override;
+
+    void predict(const float* inputs, uint32_t count) override;
+    void detections(uint32_t batchIdx, float threshold, float nmsIou, Detections& out) override;
+
+private:
+    ///
+    /// \brief checkBatch - detections of two inputs predicted in one batch are the same as predicted one by one
+    ///                     (darknet takes batch of 2 as test time flip)
+    ///
+    bool checkBatch();
+
+    network* m_net = nullptr;
+};
@@ -0,0 +1,75 @@
+//
+// The MIT License (MIT)
+//
+// Copyright 2020 Karolpg
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), 
+// to deal in the Software without restriction, including without limitation the rights to #use, copy, modify, merge, publish, distribute, sublicense, 
+// and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR #COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, 
+// WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+
+
+#include "DetectionStats.h"
+
+#include <iomanip>
+#include <sstream>
+
+DetectionStats::Snapshot DetectionStats::snapshot() const
+{
+    Snapshot s;
+    for (uint32_t st = 0; st < STAGES_COUNT; ++st) {
+        s.stages[st] = m_stages[st].snapshot();
+    }
+    for (uint32_t c = 0; c < COUNTERS_COUNT; ++c) {
+        s.counters[c] = m_counters[c].load(std::memory_order_relaxed);
+    }
+    return s;
+}
+
+std::string DetectionStats::Snapshot::toString() const
+{
+    std::stringstream ss;
+    ss << std::fixed << std::setprecision(1);
+    for (uint32_t st = 0; st < STAGES_COUNT; ++st) {
+        const LatencyHistogram::Snapshot& h = stages[st];
+        ss << std::setw(14) << stageName(static_cast<Stage>(st)) << ": " << h.count << " samples, [ms] mean " << h.mean * 1e3
+           << " p50 " << h.percentile(0.5) * 1e3 << " p90 " << h.percentile(0.9) * 1e3
+           << " p99 " << h.percentile(0.99) * 1e3 << " max " << h.max * 1e3 << "\n";
+    }
+    for (uint32_t c = 0; c < COUNTERS_COUNT; ++c) {
+        ss << (c == 0 ? "" : ", ") << counterName(static_cast<Counter>(c)) << " " << counters[c];
+    }
+    ss << "\n";
+    return ss.str();
+}
+
+const char* DetectionStats::stageName(Stage stage)
+{
+    switch (stage) {
+        case TriggerWait:   return "trigger wait";
+        case Preprocessing: return "preprocessing";
+        case Predict:       return "predict";
+        case BoxExtraction: return "box extraction";
+        case Drawing:       return "drawing";
+        case PngEncode:     return "png encode";
+        case Notify:        return "notify";
+        default:            return "?";
+    }
+}
+
+const char* DetectionStats::counterName(Counter counter)
+{
+    switch (counter) {
+        case Triggers:  return "triggers";
+        case Dropped:   return "dropped";
+        case Coalesced: return "coalesced";
+        case Reused:    return "reused";
+        default:        return "?";
+    }
+}
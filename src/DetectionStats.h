@@ -0,0 +1,69 @@
+//
+// The MIT License (MIT)
+//
+// Copyright 2020 Karolpg
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), 
+// to deal in the Software without restriction, including without limitation the rights to #use, copy, modify, merge, publish, distribute, sublicense, 
+// and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR #COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, 
+// WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <string>
+#include "LatencyHistogram.h"
+
+///
+/// \brief The DetectionStats class - latency of every stage of detection path and counters of triggers.
+///                                   Shared by all cameras of DetectorPool, updated without locks from stage threads.
+///
+class DetectionStats
+{
+public:
+    enum Stage : uint32_t {
+        TriggerWait,   // movement trigger to the start of preprocessing (time in source queue)
+        Preprocessing, // network input
+        Predict,       // inference with batching and second stage of cascade
+        BoxExtraction, // merging and filtering results
+        Drawing,       // labels on output image
+        PngEncode,
+        Notify,        // subscribers, e.g. Slack
+        STAGES_COUNT
+    };
+
+    enum Counter : uint32_t {
+        Triggers,  // submitted jobs
+        Dropped,   // replaced by newer job of the same source
+        Coalesced, // movement explained by tracked objects - no detection needed
+        Reused,    // results of recent inference of the same scene taken from ResultCache
+        COUNTERS_COUNT
+    };
+
+    struct Snapshot {
+        std::array<LatencyHistogram::Snapshot, STAGES_COUNT> stages;
+        std::array<uint64_t, COUNTERS_COUNT> counters{};
+
+        std::string toString() const; // line per stage, all counters in the last one
+    };
+
+    void record(Stage stage, std::chrono::steady_clock::duration duration) { m_stages[stage].record(duration); }
+    void count(Counter counter) { m_counters[counter].fetch_add(1, std::memory_order_relaxed); }
+
+    Snapshot snapshot() const;
+
+    static const char* stageName(Stage stage);
+    static const char* counterName(Counter counter);
+
+private:
+    std::array<LatencyHistogram, STAGES_COUNT> m_stages;
+    std::array<std::atomic<uint64_t>, COUNTERS_COUNT> m_counters{};
+};
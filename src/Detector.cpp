@@ -17,97 +17,68 @@
 #include "Detector.h"
 #include "ColorGenerator.h"
 #include "Letters.h"
+#include "Overlay.h"
 #include "PngTools.h"
-#include "ImgUtils.h"
 
-#include <darknet.h>
 #include <iostream>
 #include <fstream>
+#include <sstream>
 #include <assert.h>
 #include <cstring>
+#include <cstdlib>
 #include <array>
 #include <algorithm>
+#include <chrono>
 
 Detector::Detector(const Config& cfg)
-    : m_netThreshold(cfg.getValue("probabilityThreshold", 0.1f))
+    : Detector(cfg, std::make_shared<InferenceBatcher>(cfg),
+               cfg.getValue("detectorCascade", 0) != 0 ? std::make_shared<Cascade>(cfg) : nullptr)
+{
+}
+
+Detector::Detector(const Config& cfg, const std::shared_ptr<InferenceBatcher>& batcher, const std::shared_ptr<Cascade>& cascade)
+    : m_batcher(batcher)
+    , m_netThreshold(cfg.getValue("probabilityThreshold", 0.1f))
+    , m_nmsIou(cfg.getValue("detectorNmsIou", 0.45f))
+    , m_maxBatch(batcher->maxBatch())
+    , m_cropRegions(cfg.getValue("detectorCropRegions", 1) != 0)
+    , m_cropPadding(cfg.getValue("detectorCropPadding", 0.25f))
+    , m_cropMaxArea(cfg.getValue("detectorCropMaxArea", 0.6f))
+    , m_tiling(cfg.getValue("detectorTiling", 0) != 0)
+    , m_tileSize(cfg.getValue("detectorTileSize", 0u))
+    , m_tileOverlap(std::clamp(cfg.getValue("detectorTileOverlap", 0.2f), 0.0f, 0.9f))
+    , m_tileMotionOnly(cfg.getValue("detectorTileMotionOnly", 1) != 0)
+    , m_tileMergeOverlap(cfg.getValue("detectorTileMergeOverlap", 0.6f))
+    , m_burstMinVotes(std::max(1u, cfg.getValue("detectorBurstMinVotes", 2u)))
+    , m_burstAcceptProbability(cfg.getValue("detectorBurstAcceptProbability", 0.7f))
+    , m_burstMatchIou(cfg.getValue("detectorBurstMatchIou", 0.3f))
 {
-    const std::string& netConfigFilePath      = cfg.getValue("darknetCfgFilePath");
-    const std::string& weightsFilePath        = cfg.getValue("darknetWeightsFilePath");
     const std::string& labelsFilePath         = cfg.getValue("darknetOutLabelsFilePath");
     const std::string& expectedLabelsFilePath = cfg.getValue("validLabelsFilePath");
 
-#if defined(GPU) && GPU > 0
-    std::cout << "Detector is running with GPU\n";
-    gpu_index = cfg.getValue("detector_gpu_idx", 0);
-    #if defined(OCL) && OCL > 0
-        cl_set_device(gpu_index);
-    #endif // defined(OCL) && OCL > 0
-#else
-    std::cout << "Detector is NOT running with GPU\n";
-#endif // defined(GPU) && GPU > 0
-
-    // I have no idea why someone assumed to provide file path as non const pointer!?
-    m_net = load_network(const_cast<char*>(netConfigFilePath.c_str()), const_cast<char*>(weightsFilePath.c_str()), 0);
-    if (!m_net) {
-        std::cerr << "Can't load neural network with cfg file: " << netConfigFilePath << ", weights file: " << weightsFilePath << "\n";
+    if (!m_batcher->isValid()) {
         return;
     }
-    set_batch_network(m_net, 1);
-    srand(2222222);
+    m_backend = m_batcher->backend();
 
     readLabels(labelsFilePath, expectedLabelsFilePath);
+    prepareClassFilter(cfg);
 
-    assert(m_net->w * m_net->h * m_net->c > 0);
-
-    m_netInput.resize(static_cast<size_t>(m_net->w * m_net->h * m_net->c), 0.0f);
-    m_outNetImage.frame.data.resize(static_cast<size_t>(m_net->w * m_net->h * m_net->c), 0);
-    m_outNetImage.descr.width = static_cast<uint32_t>(m_net->w);
-    m_outNetImage.descr.height = static_cast<uint32_t>(m_net->h);
-    m_outNetImage.descr.components = static_cast<uint32_t>(m_net->c);
-}
-
-Detector::~Detector()
-{
-    if (m_net) {
-        free_network(m_net);
+    if (cascade && cascade->isValid()) {
+        m_cascade = cascade;
+        m_confirmDetector = std::make_unique<Detector>(m_cascade->config(), m_cascade->batcher());
     }
-}
 
-float avarageColor(uint32_t x, uint32_t y, uint32_t c,
-                       const uint8_t* data, uint32_t width, uint32_t height, uint32_t components,
-                       double wAspect, double hAspect)
-{
-    assert(c <= components);
-    if (wAspect >= 1.0) {
-        if (hAspect >= 1.0) {
-            uint32_t rawX = static_cast<uint32_t>(wAspect * x);
-            uint32_t rawY = static_cast<uint32_t>(hAspect * y);
-            uint32_t accColor = 0;
-
-            uint32_t maskX = static_cast<uint32_t>(wAspect + 0.5);
-            uint32_t maskY = static_cast<uint32_t>(hAspect + 0.5);
-            uint32_t rawXEnd = std::min(rawX+maskX, width);
-            uint32_t rawYEnd = std::min(rawY+maskY, height);
-            uint32_t maskSize = (rawXEnd - rawX) * (rawYEnd - rawY);
-
-            for (uint32_t imgY = rawY; imgY < rawYEnd; ++imgY) {
-                for (uint32_t imgX = rawX; imgX < rawXEnd; ++imgX) {
-                    accColor += data[(imgY*width+imgX)*components + c];
-                }
-            }
-            return float(accColor) / maskSize / 255.0f;
-        }
-        else {
-            assert(!"Not implemented yet!");
-        }
-    }
-    else {
-        assert(!"Not implemented yet!");
-    }
-    return 0.f;
+    assert(m_backend->inputSize() > 0);
+
+    m_netInput.resize(m_backend->inputSize() * m_maxBatch, 0.0f);
+    m_outNetImage.frame.data.resize(m_backend->inputSize(), 0);
+    m_outNetImage.descr.width = m_backend->width();
+    m_outNetImage.descr.height = m_backend->height();
+    m_outNetImage.descr.components = m_backend->channels();
 }
 
-void Detector::setInput(const FrameU8 &frame, const FrameDescr &descr)
+void Detector::setInput(const FrameU8 &frame, const FrameDescr &descr, const std::vector<DetectionBox>& regions)
 {
     assert(frame.data.size());
     assert(descr.width);
@@ -116,86 +87,579 @@ void Detector::setInput(const FrameU8 &frame, const FrameDescr &descr)
 
     m_inImage.frame = frame;
     m_inImage.descr = descr;
+    m_sharedFrame = nullptr;
+    m_regions = regions;
+    m_burstFrames.clear();
     m_outNetImage.frame.nr = frame.nr;
     m_outNetImage.frame.time = frame.time;
     m_outNetImage.frame.bufferIdx = frame.bufferIdx;
 }
 
+void Detector::setSharedInput(const Detector& outer, const std::vector<DetectionBox>& regions)
+{
+    const FrameU8& frame = outer.inFrame();
+    assert(frame.data.size());
+
+    // only crops of outer frame are read - pixels are not copied
+    m_sharedFrame = &frame;
+    m_inImage.frame.nr = frame.nr;
+    m_inImage.frame.time = frame.time;
+    m_inImage.frame.bufferIdx = frame.bufferIdx;
+    m_inImage.frame.data.clear();
+    m_inImage.descr = outer.m_inImage.descr;
+    m_regions = regions;
+    m_burstFrames.clear();
+    m_outNetImage.frame.nr = frame.nr;
+    m_outNetImage.frame.time = frame.time;
+    m_outNetImage.frame.bufferIdx = frame.bufferIdx;
+}
+
+void Detector::setBurstFrames(std::vector<FrameU8>&& frames)
+{
+    m_burstFrames = std::move(frames);
+    assert(std::all_of(m_burstFrames.begin(), m_burstFrames.end(), [this] (const FrameU8& frame) {
+        return frame.data.size() == inFrame().data.size();
+    }));
+}
+
 bool Detector::detect()
+{
+    if (!prepare()) {
+        return false;
+    }
+    infer();
+    return finish();
+}
+
+bool Detector::prepare()
 {
     m_lastDetections.clear();
+    m_sliceDetections.clear();
+    m_sliceTruncated.clear();
+    m_sliceFrames.clear();
     m_outNetImageHasLabels = false;
     m_inImageHasLabels = false;
 
-    assert(m_inImage.frame.data.size());
+    assert(inFrame().data.size());
 
-    if (!m_net) {
+    if (!m_backend) {
         assert(!"Network not created!\n");
         return false;
     }
 
-    const uint32_t w = static_cast<uint32_t>(m_net->w);
-    const uint32_t h = static_cast<uint32_t>(m_net->h);
-    const uint32_t c = static_cast<uint32_t>(m_net->c);
-    m_netScaledImageX = 0;
-    m_netScaledImageY = 0;
-    m_netScaledImageW = 0;
-    m_netScaledImageH = 0;
-    std::array<float, 3> clearValue = {0.5f, 0.5f, 0.5f};
+    prepareSlices();
+
+    // the same slices of burst frames - all of them are predicted in common batches
+    const size_t inputSlices = m_slices.size();
+    for (uint32_t f = 1; f <= m_burstFrames.size(); ++f) {
+        for (size_t s = 0; s < inputSlices; ++s) {
+            m_slices.push_back(m_slices[s]);
+            m_slices.back().frame = f;
+        }
+    }
 
-    ImgUtils::resize(m_inImage.descr.width, m_inImage.descr.height, m_inImage.descr.components, m_inImage.frame.data.data(), ImgUtils::DT_Uint8, ImgUtils::Pixel, 0,
-                     w, h, c, m_netInput.data(), ImgUtils::DT_Float32, ImgUtils::Component, 0, true,
-                     clearValue.data(),
-                     &m_netScaledImageX, &m_netScaledImageY, &m_netScaledImageW, &m_netScaledImageH);
+    const size_t netInputSize = m_backend->inputSize();
+    if (m_netInput.size() < m_slices.size() * netInputSize) {
+        m_netInput.resize(m_slices.size() * netInputSize); // tiles can exceed one batch
+    }
+    for (uint32_t i = 0; i < m_slices.size(); ++i) {
+        fillNetInput(m_slices[i], &m_netInput[i*netInputSize]);
+    }
 
     //{
     //    image im;
-    //    im.c = m_net->c;
-    //    im.w = m_net->w;
-    //    im.h = m_net->h;
+    //    im.c = m_backend->channels();
+    //    im.w = m_backend->width();
+    //    im.h = m_backend->height();
     //    im.data = m_netInput.data();
     //    save_image(im, "/tmp/predictions1");
     //}
 
-    //auto beginPrediction = std::chrono::steady_clock::now();
+    return true;
+}
+
+void Detector::reuseResults(const std::vector<ResultCache::Result>& results)
+{
+    m_lastDetections.clear();
+    m_sliceDetections.clear();
+    m_sliceTruncated.clear();
+    m_slices.clear(); // nothing to infer
+    m_outNetImageHasLabels = false;
+    m_inImageHasLabels = false;
 
-    network_predict(m_net, m_netInput.data());
+    for (const ResultCache::Result& result : results) {
+        if (result.classId < m_labels.size()) {
+            m_lastDetections.push_back({result.classId, m_labels[result.classId], result.probability, result.box});
+        }
+    }
+}
 
-    //std::chrono::duration<double> predictionTime = std::chrono::steady_clock::now() - beginPrediction;
+std::vector<DetectionBox> Detector::inspectedRegions() const
+{
+    const float frameW = static_cast<float>(m_inImage.descr.width);
+    const float frameH = static_cast<float>(m_inImage.descr.height);
+    if (m_slices.empty()) {
+        // reused results cover regions of the trigger
+        return m_regions.empty() ? std::vector<DetectionBox>{{0.5f, 0.5f, 1.0f, 1.0f}} : m_regions;
+    }
+
+    std::vector<DetectionBox> inspected;
+    for (const Slice& slice : m_slices) {
+        if (slice.frame == 0) { // burst frames repeat slices of input frame
+            inspected.push_back(BoxUtils::fromEdges(slice.cropX / frameW, slice.cropY / frameH,
+                                                    (slice.cropX + slice.cropW) / frameW, (slice.cropY + slice.cropH) / frameH));
+        }
+    }
+    return inspected;
+}
+
+void Detector::infer()
+{
+    if (!m_backend || m_slices.empty()) {
+        return;
+    }
+    auto beginPrediction = std::chrono::steady_clock::now();
+
+    // slices can be predicted together with inputs of other detectors sharing the batcher,
+    // source is attached while its requests are sent - the batcher waits for its next chunk
+    const size_t netInputSize = m_backend->inputSize();
+    m_batcher->attachSource();
+    for (uint32_t first = 0; first < m_slices.size(); first += m_maxBatch) {
+        InferenceBatcher::Request request;
+        request.inputs = &m_netInput[first*netInputSize];
+        request.count = std::min(m_maxBatch, static_cast<uint32_t>(m_slices.size()) - first);
+        request.collect = [this, first] (InferenceBackend& backend, uint32_t batchIdx, uint32_t inputIdx) {
+            collectDetections(backend, batchIdx, m_slices[first + inputIdx]);
+        };
+        m_batcher->run(request);
+    }
+    m_batcher->detachSource();
+
+    std::chrono::duration<double> predictionTime = std::chrono::steady_clock::now() - beginPrediction;
     //std::cout << "Prediction time: " << predictionTime.count() << "[s]\n";
 
-    int nboxes = 0;
-    float hier = 0.5f;
-    int *map = nullptr;
-    int relative = 1;
-
-    detection *dets = get_network_boxes(m_net, static_cast<int>(m_inImage.descr.width), static_cast<int>(m_inImage.descr.height), m_netThreshold, hier, map, relative, &nboxes);
-
-    for (int i = 0; i < nboxes; ++i) {
-        for(auto expectedLabel : m_expectedLabelColors){
-            uint32_t objClass = expectedLabel.first;
-            assert(static_cast<int>(objClass) < m_net->layers[m_net->n-1].classes); // const layer& lastLayer = m_net->layers[m_net->n-1];
-            if (dets[i].prob[objClass] > m_netThreshold) {
-               m_lastDetections.push_back({objClass,
-                                           m_labels[objClass],
-                                           dets[i].prob[objClass],
-                                           {dets[i].bbox.x, dets[i].bbox.y, dets[i].bbox.w, dets[i].bbox.h}
-                                          });
+    if (m_cascade) {
+        // second stage needs merged results of the first one
+        mergeResults();
+        confirmResults(predictionTime.count());
+    }
+}
+
+bool Detector::finish()
+{
+    if (!m_cascade) {
+        mergeResults();
+    }
+    return !m_lastDetections.empty();
+}
+
+void Detector::confirmResults(double firstStageTime)
+{
+    std::vector<DetectionResult>& results = m_confirmedResults;
+    results.clear();
+    m_confirmRegions.clear();
+    m_confirmCandidates.clear();
+    for (size_t i = 0; i < m_lastDetections.size(); ++i) {
+        const DetectionResult& dr = m_lastDetections[i];
+        if (m_cascade->needsConfirmation(dr.label, dr.probablity)) {
+            m_confirmRegions.push_back(dr.box);
+            m_confirmCandidates.push_back(i);
+        }
+        else {
+            results.push_back(dr);
+        }
+    }
+    m_cascade->addFirstStage(results.size(), m_confirmCandidates.size(), firstStageTime);
+    if (m_confirmCandidates.empty()) {
+        return;
+    }
+
+    // heavy network on crops around candidates, candidate is confirmed by overlapping result of the same class
+    auto beginConfirmation = std::chrono::steady_clock::now();
+    m_confirmDetector->setSharedInput(*this, m_confirmRegions);
+    m_confirmDetector->detect();
+    const std::vector<DetectionResult>& confirmations = m_confirmDetector->lastResults();
+
+    uint64_t confirmed = 0;
+    for (size_t candidateIdx : m_confirmCandidates) {
+        const DetectionResult& candidate = m_lastDetections[candidateIdx];
+        const DetectionResult* best = nullptr;
+        for (const DetectionResult& confirmation : confirmations) {
+            if (confirmation.classId == candidate.classId
+                && BoxUtils::iou(confirmation.box, candidate.box) >= m_cascade->confirmIou()
+                && (!best || confirmation.probablity > best->probablity)) {
+                best = &confirmation;
             }
         }
+        if (best) {
+            // second stage is more precise - its probability and box are taken, label of this detector
+            results.push_back({candidate.classId, candidate.label, best->probablity, best->box});
+            ++confirmed;
+        }
     }
+    m_lastDetections.swap(results);
 
-    free_detections(dets, nboxes);
+    std::chrono::duration<double> confirmationTime = std::chrono::steady_clock::now() - beginConfirmation;
+    m_cascade->addSecondStage(confirmed, m_confirmCandidates.size() - confirmed, confirmationTime.count());
+}
 
-    return !m_lastDetections.empty();
+void Detector::prepareSlices()
+{
+    m_slices.clear();
+
+    const uint32_t frameW = m_inImage.descr.width;
+    const uint32_t frameH = m_inImage.descr.height;
+
+    if (m_tiling && prepareTiles()) {
+        return;
+    }
+
+    if (m_cropRegions && !m_regions.empty()) {
+        // Crop is at least as big as network input. Then small objects are not scaled down,
+        // and the rest of network input is filled with real neighbourhood instead of padding.
+        const float minCropW = std::min(1.0f, static_cast<float>(m_backend->width()) / frameW);
+        const float minCropH = std::min(1.0f, static_cast<float>(m_backend->height()) / frameH);
+        std::vector<DetectionBox> crops;
+        crops.reserve(m_regions.size());
+        for (const DetectionBox& region : m_regions) {
+            float cropW = std::clamp(region.w * (1.0f + 2.0f*m_cropPadding), minCropW, 1.0f);
+            float cropH = std::clamp(region.h * (1.0f + 2.0f*m_cropPadding), minCropH, 1.0f);
+            float cropX = std::clamp(region.x, cropW / 2.0f, 1.0f - cropW / 2.0f);
+            float cropY = std::clamp(region.y, cropH / 2.0f, 1.0f - cropH / 2.0f);
+            crops.push_back({cropX, cropY, cropW, cropH});
+        }
+        BoxUtils::mergeOverlapping(crops, 0.5f);
+
+        float cropsArea = 0.0f;
+        for (const DetectionBox& crop : crops) {
+            cropsArea += BoxUtils::area(crop);
+        }
+
+        if (crops.size() <= m_maxBatch && cropsArea <= m_cropMaxArea) {
+            for (const DetectionBox& crop : crops) {
+                uint32_t left   = static_cast<uint32_t>(std::max(0.0f, BoxUtils::left(crop) * frameW));
+                uint32_t top    = static_cast<uint32_t>(std::max(0.0f, BoxUtils::top(crop) * frameH));
+                uint32_t right  = std::min(frameW, static_cast<uint32_t>(BoxUtils::right(crop) * frameW + 0.5f));
+                uint32_t bottom = std::min(frameH, static_cast<uint32_t>(BoxUtils::bottom(crop) * frameH + 0.5f));
+                if (right > left && bottom > top) {
+                    m_slices.push_back(makeSlice(left, top, right - left, bottom - top));
+                }
+            }
+            if (!m_slices.empty()) {
+                return;
+            }
+        }
+    }
+
+    // whole frame
+    m_slices.push_back(makeSlice(0, 0, frameW, frameH));
+}
+
+bool Detector::prepareTiles()
+{
+    const uint32_t frameW = m_inImage.descr.width;
+    const uint32_t frameH = m_inImage.descr.height;
+    const uint32_t tileW = std::min(frameW, m_tileSize ? m_tileSize : m_backend->width());
+    const uint32_t tileH = std::min(frameH, m_tileSize ? m_tileSize : m_backend->height());
+    if (tileW == frameW && tileH == frameH) {
+        return false; // whole frame is already near native scale
+    }
+
+    // tiles spread evenly, neighbours overlap at least m_tileOverlap of tile
+    auto tileStarts = [this] (uint32_t frameSize, uint32_t tileSize) {
+        const uint32_t step = std::max(1u, static_cast<uint32_t>(tileSize * (1.0f - m_tileOverlap)));
+        const uint32_t count = frameSize > tileSize ? 1 + (frameSize - tileSize + step - 1) / step : 1;
+        std::vector<uint32_t> starts(count, 0);
+        for (uint32_t i = 1; i < count; ++i) {
+            starts[i] = static_cast<uint32_t>((static_cast<uint64_t>(frameSize - tileSize) * i + (count - 1) / 2) / (count - 1));
+        }
+        return starts;
+    };
+    const std::vector<uint32_t> startsX = tileStarts(frameW, tileW);
+    const std::vector<uint32_t> startsY = tileStarts(frameH, tileH);
+
+    // whole frame is the first slice - objects bigger than tile are found there
+    m_slices.push_back(makeSlice(0, 0, frameW, frameH));
+    for (uint32_t y : startsY) {
+        for (uint32_t x : startsX) {
+            DetectionBox tile = BoxUtils::fromEdges(static_cast<float>(x) / frameW, static_cast<float>(y) / frameH,
+                                                    static_cast<float>(x + tileW) / frameW, static_cast<float>(y + tileH) / frameH);
+            bool hasMotion = m_regions.empty() || std::any_of(m_regions.begin(), m_regions.end(), [&tile] (const DetectionBox& region) {
+                return BoxUtils::intersection(tile, region) > 0.0f;
+            });
+            if (!m_tileMotionOnly || hasMotion) {
+                m_slices.push_back(makeSlice(x, y, tileW, tileH));
+            }
+        }
+    }
+    return true;
+}
+
+Detector::Slice Detector::makeSlice(uint32_t cropX, uint32_t cropY, uint32_t cropW, uint32_t cropH) const
+{
+    const uint32_t netW = m_backend->width();
+    const uint32_t netH = m_backend->height();
+
+    Slice slice;
+    slice.cropX = cropX;
+    slice.cropY = cropY;
+    slice.cropW = cropW;
+    slice.cropH = cropH;
+    if (cropW <= netW && cropH <= netH) {
+        // native resolution
+        slice.netW = cropW;
+        slice.netH = cropH;
+    }
+    else if ((static_cast<float>(netW)/cropW) < (static_cast<float>(netH)/cropH)) {
+        slice.netW = netW;
+        slice.netH = (cropH * netW)/cropW;
+    }
+    else {
+        slice.netH = netH;
+        slice.netW = (cropW * netH)/cropH;
+    }
+    slice.netX = (netW - slice.netW)/2;
+    slice.netY = (netH - slice.netH)/2;
+    return slice;
+}
+
+void Detector::fillNetInput(const Slice& slice, float* netInput)
+{
+    const uint32_t frameW = m_inImage.descr.width;
+    const uint32_t frameC = m_inImage.descr.components;
+    const FrameU8& frame = slice.frame == 0 ? inFrame() : m_burstFrames[slice.frame - 1];
+    const uint8_t* cropData = &frame.data[(slice.cropY*frameW + slice.cropX)*frameC];
+
+    Letterbox::Geometry geometry;
+    geometry.inW = slice.cropW;
+    geometry.inH = slice.cropH;
+    geometry.inC = frameC;
+    geometry.outW = m_backend->width();
+    geometry.outH = m_backend->height();
+    geometry.outC = m_backend->channels();
+    geometry.newX = slice.netX;
+    geometry.newY = slice.netY;
+    geometry.newW = slice.netW;
+    geometry.newH = slice.netH;
+
+    // crop is read in place - row stride of the whole frame
+    getLetterbox(geometry).run(cropData, static_cast<size_t>(frameW)*frameC, netInput, 0.5f);
+}
+
+const Letterbox& Detector::getLetterbox(const Letterbox::Geometry& geometry)
+{
+    // full frame slice repeats every frame, crops around movement repeat while object moves slowly
+    auto it = std::find_if(m_letterboxes.begin(), m_letterboxes.end(), [&geometry] (const std::unique_ptr<Letterbox>& lb) {
+        return lb->geometry() == geometry;
+    });
+    if (it != m_letterboxes.end()) {
+        std::rotate(m_letterboxes.begin(), it, it + 1); // most recently used first
+        return *m_letterboxes.front();
+    }
+
+    if (m_letterboxes.size() >= LETTERBOX_CACHE_SIZE) {
+        m_letterboxes.pop_back();
+    }
+    m_letterboxes.insert(m_letterboxes.begin(), std::make_unique<Letterbox>(geometry));
+    return *m_letterboxes.front();
+}
+
+void Detector::collectDetections(InferenceBackend& backend, uint32_t batchIdx, const Slice& slice)
+{
+    // boxes relative to network input, they are moved to the frame below
+    backend.detections(batchIdx, m_minClassThreshold, m_nmsIou, m_rawDetections);
+    const uint32_t classes = backend.classes();
+    const float netW = static_cast<float>(backend.width());
+    const float netH = static_cast<float>(backend.height());
+
+    const float frameW = static_cast<float>(m_inImage.descr.width);
+    const float frameH = static_cast<float>(m_inImage.descr.height);
+    const float scaleX = static_cast<float>(slice.cropW) / slice.netW; // net px -> frame px
+    const float scaleY = static_cast<float>(slice.cropH) / slice.netH;
+
+    // box reaching slice border which is not frame border can be part of object only
+    const float edgeMarginX = 2.0f * scaleX / frameW; // 2 network pixels
+    const float edgeMarginY = 2.0f * scaleY / frameH;
+    const float cropLeft   = slice.cropX / frameW;
+    const float cropTop    = slice.cropY / frameH;
+    const float cropRight  = (slice.cropX + slice.cropW) / frameW;
+    const float cropBottom = (slice.cropY + slice.cropH) / frameH;
+
+    for (size_t i = 0; i < m_rawDetections.boxes.size(); ++i) {
+        const DetectionBox& b = m_rawDetections.boxes[i];
+        DetectionBox frameBox;
+        frameBox.x = ((b.x * netW - slice.netX) * scaleX + slice.cropX) / frameW;
+        frameBox.y = ((b.y * netH - slice.netY) * scaleY + slice.cropY) / frameH;
+        frameBox.w = b.w * netW * scaleX / frameW;
+        frameBox.h = b.h * netH * scaleY / frameH;
+        const bool truncated = (slice.cropX > 0 && BoxUtils::left(frameBox) <= cropLeft + edgeMarginX)
+                            || (slice.cropY > 0 && BoxUtils::top(frameBox) <= cropTop + edgeMarginY)
+                            || (slice.cropX + slice.cropW < m_inImage.descr.width && BoxUtils::right(frameBox) >= cropRight - edgeMarginX)
+                            || (slice.cropY + slice.cropH < m_inImage.descr.height && BoxUtils::bottom(frameBox) >= cropBottom - edgeMarginY);
+
+        const float* prob = &m_rawDetections.probabilities[i * classes];
+        for (uint32_t objClass : m_expectedClasses) {
+            if (prob[objClass] > m_classThresholds[objClass]) {
+               m_sliceDetections.push_back({objClass,
+                                            m_labels[objClass],
+                                            prob[objClass],
+                                            frameBox
+                                           });
+               m_sliceTruncated.push_back(truncated);
+               m_sliceFrames.push_back(slice.frame);
+            }
+        }
+    }
+}
+
+namespace {
+
+/// 1D IoU of ranges [begin, end)
+float spanOverlap(float aBegin, float aEnd, float bBegin, float bEnd)
+{
+    float common = std::min(aEnd, bEnd) - std::max(aBegin, bBegin);
+    float all = std::max(aEnd, bEnd) - std::min(aBegin, bBegin);
+    return common > 0.0f && all > 0.0f ? common / all : 0.0f;
+}
+
+} // namespace
+
+void Detector::mergeResults()
+{
+    removeDuplicates();
+    if (!m_burstFrames.empty()) {
+        voteBurst();
+    }
+}
+
+void Detector::removeDuplicates()
+{
+    // Crops and tiles overlap, so the same object can be found more than once - keep the most probable.
+    // Object cut by tile border gives smaller box, so IoU with the whole one is low - such box is merged when
+    // most of it is covered by other detection. Whole boxes go first, parts of object seen only in pieces are united.
+    const float sameObjectIou = m_nmsIou > 0.0f ? m_nmsIou : 0.5f;
+    std::vector<size_t>& order = m_mergeOrder;
+    order.resize(m_sliceDetections.size());
+    for (size_t i = 0; i < order.size(); ++i) {
+        order[i] = i;
+    }
+    std::stable_sort(order.begin(), order.end(), [this] (size_t a, size_t b) {
+        if (m_sliceTruncated[a] != m_sliceTruncated[b]) {
+            return !m_sliceTruncated[a];
+        }
+        return m_sliceDetections[a].probablity > m_sliceDetections[b].probablity;
+    });
+
+    std::vector<bool>& keptTruncated = m_keptTruncated;
+    keptTruncated.clear();
+    m_keptFrames.clear();
+    for (size_t i : order) {
+        const DetectionResult& candidate = m_sliceDetections[i];
+        const bool candidateTruncated = m_sliceTruncated[i];
+        bool isDuplicate = false;
+        for (size_t k = 0; k < m_lastDetections.size() && !isDuplicate; ++k) {
+            DetectionResult& kept = m_lastDetections[k];
+            if (candidate.classId != kept.classId || m_sliceFrames[i] != m_keptFrames[k]) {
+                continue; // burst frames are voted after
+            }
+            if (BoxUtils::iou(candidate.box, kept.box) > sameObjectIou) {
+                isDuplicate = true;
+            }
+            else if (candidateTruncated && keptTruncated[k]) {
+                // pieces from neighbour tiles - they overlap and are aligned across the border
+                isDuplicate = BoxUtils::intersection(candidate.box, kept.box) > 0.0f
+                           && std::max(spanOverlap(BoxUtils::left(candidate.box), BoxUtils::right(candidate.box), BoxUtils::left(kept.box), BoxUtils::right(kept.box)),
+                                       spanOverlap(BoxUtils::top(candidate.box), BoxUtils::bottom(candidate.box), BoxUtils::top(kept.box), BoxUtils::bottom(kept.box))) >= m_tileMergeOverlap;
+                if (isDuplicate) {
+                    kept.box = BoxUtils::unite(kept.box, candidate.box);
+                }
+            }
+            else if (candidateTruncated || keptTruncated[k]) {
+                float smaller = std::min(BoxUtils::area(candidate.box), BoxUtils::area(kept.box));
+                isDuplicate = smaller > 0.0f && BoxUtils::intersection(candidate.box, kept.box) / smaller >= m_tileMergeOverlap;
+            }
+        }
+        if (!isDuplicate) {
+            m_lastDetections.push_back(candidate);
+            keptTruncated.push_back(candidateTruncated);
+            m_keptFrames.push_back(m_sliceFrames[i]);
+        }
+    }
+}
+
+void Detector::voteBurst()
+{
+    // Track - detections of one object in different frames, at most one per frame. Frames are taken one by one,
+    // detection joins track of its class with the best IoU to any member, or starts new one.
+    struct Track {
+        std::vector<size_t> members; // indexes in m_lastDetections
+        size_t best;                 // the most probable member
+        int inputMember = -1;        // member from input frame - its box fits reported image
+        uint32_t lastFrame;
+    };
+    std::vector<Track> tracks;
+    const uint32_t frames = static_cast<uint32_t>(m_burstFrames.size()) + 1;
+    for (uint32_t f = 0; f < frames; ++f) {
+        const size_t firstTrackOfFrame = tracks.size(); // detections of the same frame never share track
+        for (size_t d = 0; d < m_lastDetections.size(); ++d) {
+            if (m_keptFrames[d] != f) {
+                continue;
+            }
+            const DetectionResult& dr = m_lastDetections[d];
+            Track* match = nullptr;
+            float matchIou = m_burstMatchIou;
+            for (size_t t = 0; t < firstTrackOfFrame; ++t) {
+                Track& track = tracks[t];
+                if (track.lastFrame == f || m_lastDetections[track.best].classId != dr.classId) {
+                    continue;
+                }
+                for (size_t member : track.members) {
+                    float iou = BoxUtils::iou(m_lastDetections[member].box, dr.box);
+                    if (iou >= matchIou) {
+                        match = &track;
+                        matchIou = iou;
+                    }
+                }
+            }
+            if (!match) {
+                tracks.push_back(Track{{}, d, -1, f});
+                match = &tracks.back();
+            }
+            match->members.push_back(d);
+            match->lastFrame = f;
+            if (dr.probablity > m_lastDetections[match->best].probablity) {
+                match->best = d;
+            }
+            if (f == 0) {
+                match->inputMember = static_cast<int>(d);
+            }
+        }
+    }
+
+    const uint32_t minVotes = std::min(m_burstMinVotes, frames);
+    std::vector<DetectionResult>& results = m_confirmedResults;
+    results.clear();
+    for (const Track& track : tracks) {
+        const DetectionResult& best = m_lastDetections[track.best];
+        if (track.members.size() < minVotes && best.probablity < m_burstAcceptProbability) {
+            continue;
+        }
+        // max confidence of track, box from input frame when object is there
+        const DetectionBox& box = track.inputMember >= 0 ? m_lastDetections[static_cast<size_t>(track.inputMember)].box : best.box;
+        results.push_back({best.classId, best.label, best.probablity, box});
+    }
+    m_lastDetections.swap(results);
 }
 
 
 const Detector::Image& Detector::getNetOutImg()
 {
-    uint32_t w = static_cast<uint32_t>(m_net->w);
-    uint32_t h = static_cast<uint32_t>(m_net->h);
-    uint32_t c = static_cast<uint32_t>(m_net->c);
+    if (m_slices.empty()) {
+        return m_outNetImage; // reused results - network input wasn't prepared
+    }
+    uint32_t w = m_backend->width();
+    uint32_t h = m_backend->height();
+    uint32_t c = m_backend->channels();
 
     if (!m_outNetImageHasLabels) {
         #pragma omp parallel for
@@ -208,8 +672,13 @@ const Detector::Image& Detector::getNetOutImg()
             }
         }
 
+        // results are relative to frame - move them to the first crop placed in network input
+        const Slice& slice = m_slices.front();
+        const float scaleX = static_cast<float>(slice.netW) / slice.cropW;
+        const float scaleY = static_cast<float>(slice.netH) / slice.cropH;
         drawResults(m_outNetImage.frame.data, m_outNetImage.descr.width, m_outNetImage.descr.height, m_outNetImage.descr.components,
-                    m_netScaledImageX, m_netScaledImageY, m_netScaledImageW, m_netScaledImageH);
+                    static_cast<int>(slice.netX - slice.cropX * scaleX), static_cast<int>(slice.netY - slice.cropY * scaleY),
+                    m_inImage.descr.width * scaleX, m_inImage.descr.height * scaleY);
 
         m_outNetImageHasLabels = true;
     }
@@ -229,67 +698,35 @@ const Detector::Image& Detector::getLabeledInImg()
 
 void Detector::drawResults(std::vector<uint8_t>& data, uint32_t w, uint32_t h, uint32_t c)
 {
-    drawResults(data, w, h, c, 0, 0, w, h);
+    drawResults(data, w, h, c, 0, 0, static_cast<float>(w), static_cast<float>(h));
 }
 
-void Detector::drawResults(std::vector<uint8_t>& data, uint32_t w, uint32_t h, uint32_t c, uint32_t imgX, uint32_t imgY, uint32_t validAreaW, uint32_t validAreaH)
+void Detector::drawResults(std::vector<uint8_t>& data, uint32_t w, uint32_t h, uint32_t c, int imgX, int imgY, float validAreaW, float validAreaH)
 {
     assert(data.size() == w*h*c);
     const uint32_t BT = 3; // BT - BORDER THICKNESS
+    const uint32_t LABEL_HEIGHT = 16; // [px]
     const int LOWEST_BORDER_CENTER = BT/2; //just to not cast
     const int HIGHEST_H_BORDER_CENTER = static_cast<int>(h - 1 - BT/2);
     const int HIGHEST_W_BORDER_CENTER = static_cast<int>(w - 1 - BT/2);
 
+    const Overlay::Canvas canvas{data.data(), w, h, c};
     for (const DetectionResult& dr : m_lastDetections) {
         uint32_t labelColor = m_expectedLabelColors[static_cast<uint32_t>(dr.classId)];
-        std::array<uint8_t, 4> BC; //BC - BORDER_COLOR
-        BC[0] = static_cast<uint8_t>(labelColor);
-        BC[1] = static_cast<uint8_t>(labelColor >> 8);
-        BC[2] = static_cast<uint8_t>(labelColor >> 16);
-        BC[3] = static_cast<uint8_t>(labelColor >> 24);
 
         //int type because of potential negative value
         int rawLeft   = static_cast<int>((dr.box.x - dr.box.w / 2.0f) * validAreaW + imgX);
         int rawRight  = static_cast<int>((dr.box.x + dr.box.w / 2.0f) * validAreaW + imgX);
         int rawTop    = static_cast<int>((dr.box.y - dr.box.h / 2.0f) * validAreaH + imgY);
         int rawBottom = static_cast<int>((dr.box.y + dr.box.h / 2.0f) * validAreaH + imgY);
-        uint32_t left   = static_cast<uint32_t>(std::clamp(rawLeft  , LOWEST_BORDER_CENTER, HIGHEST_W_BORDER_CENTER));
-        uint32_t right  = static_cast<uint32_t>(std::clamp(rawRight , LOWEST_BORDER_CENTER, HIGHEST_W_BORDER_CENTER));
-        uint32_t top    = static_cast<uint32_t>(std::clamp(rawTop   , LOWEST_BORDER_CENTER, HIGHEST_H_BORDER_CENTER));
-        uint32_t bottom = static_cast<uint32_t>(std::clamp(rawBottom, LOWEST_BORDER_CENTER, HIGHEST_H_BORDER_CENTER));
-
-        for (uint32_t k = 0; k < c; ++k) {
-            uint8_t kVal = BC[k % BC.size()];
-            //top
-            for (uint32_t y = top - BT/2; y < top + BT/2; ++y) {
-                for (uint32_t x = left; x < right; ++x) {
-                    data[(y*w+x)*c+k] = kVal;
-                }
-            }
-
-            //bottom
-            for (uint32_t y = bottom - BT/2; y < bottom + BT/2; ++y) {
-                for (uint32_t x = left; x < right; ++x) {
-                    data[(y*w+x)*c+k] = kVal;
-                }
-            }
-
-            //left
-            for (uint32_t x = left - BT/2; x < left + BT/2; ++x) {
-                for (uint32_t y = top; y < bottom; ++y) {
-                    data[(y*w+x)*c+k] = kVal;
-                }
-            }
-
-            //right
-            for (uint32_t x = right - BT/2; x < right + BT/2; ++x) {
-                for (uint32_t y = top; y < bottom; ++y) {
-                    data[(y*w+x)*c+k] = kVal;
-                }
-            }
-
-            drawString(data, w, h, c, left + BT/2 + 1, top + BT/2 + 1, dr.label, 0.5f, labelColor, true);
-        }
+        // box partially outside of image has its border on image edge
+        int left   = std::clamp(rawLeft  , LOWEST_BORDER_CENTER, HIGHEST_W_BORDER_CENTER);
+        int right  = std::clamp(rawRight , LOWEST_BORDER_CENTER, HIGHEST_W_BORDER_CENTER);
+        int top    = std::clamp(rawTop   , LOWEST_BORDER_CENTER, HIGHEST_H_BORDER_CENTER);
+        int bottom = std::clamp(rawBottom, LOWEST_BORDER_CENTER, HIGHEST_H_BORDER_CENTER);
+
+        Overlay::drawBox(canvas, left, top, right, bottom, BT, labelColor);
+        Overlay::drawText(canvas, left + BT/2 + 1, top + BT/2 + 1, dr.label, LABEL_HEIGHT, labelColor);
     }
 }
 
@@ -362,6 +799,58 @@ void Detector::readLabels(const std::string& labelsFilePath, const std::string&
     }
 }
 
+void Detector::prepareClassFilter(const Config& cfg)
+{
+    const uint32_t classes = m_backend->classes();
+
+    m_classThresholds.assign(classes, m_netThreshold);
+    std::istringstream thresholds(cfg.getValue("classThresholds"));
+    std::string entry; // label:threshold
+    while (thresholds >> entry) {
+        size_t colon = entry.rfind(':');
+        auto labelIt = std::find(m_labels.begin(), m_labels.end(), entry.substr(0, colon));
+        float threshold = -1.0f;
+        if (colon != std::string::npos && colon + 1 < entry.size()) {
+            const char* value = entry.c_str() + colon + 1;
+            char* valueEnd = nullptr;
+            threshold = std::strtof(value, &valueEnd);
+            if (*valueEnd != '\0') {
+                threshold = -1.0f; // e.g. "person:x" or "person:0.5x"
+            }
+        }
+        if (colon == std::string::npos || labelIt == m_labels.end() || static_cast<uint32_t>(labelIt - m_labels.begin()) >= classes
+            || !(threshold >= 0.0f && threshold <= 1.0f)) {
+            std::cout << "[WARNING] Invalid class threshold: " << entry << "\n";
+            continue;
+        }
+        m_classThresholds[static_cast<size_t>(labelIt - m_labels.begin())] = threshold;
+    }
+
+    // dense list instead of labels map iteration for every box
+    m_expectedClasses.clear();
+    for (const auto& labelPair : m_expectedLabelColors) {
+        if (labelPair.first >= classes) {
+            std::cout << "[WARNING] Label: " << m_labels[labelPair.first] << " is not network class.\n";
+            continue;
+        }
+        m_expectedClasses.push_back(labelPair.first);
+    }
+    std::sort(m_expectedClasses.begin(), m_expectedClasses.end());
+
+    m_minClassThreshold = m_netThreshold;
+    for (uint32_t objClass : m_expectedClasses) {
+        m_minClassThreshold = std::min(m_minClassThreshold, m_classThresholds[objClass]);
+    }
+
+    m_sliceDetections.reserve(RESULTS_RESERVE);
+    m_sliceTruncated.reserve(RESULTS_RESERVE);
+    m_lastDetections.reserve(RESULTS_RESERVE);
+    m_mergeOrder.reserve(RESULTS_RESERVE);
+    m_keptTruncated.reserve(RESULTS_RESERVE);
+    m_sliceFrames.reserve(RESULTS_RESERVE);
+    m_keptFrames.reserve(RESULTS_RESERVE);
+}
+
 void Detector::generateLabelsImg() const
 {
     uint32_t labelW = 600;
@@ -398,8 +887,8 @@ void Detector::generateLabelsImg() const
             }
         }
 
-        drawString(labelsImg.frame.data, labelsImg.descr.width, labelsImg.descr.height, labelsImg.descr.components,
-                   textX, labelH*i + textY, labelText, 1.0f, labelColor, true);
+        const Overlay::Canvas canvas{labelsImg.frame.data.data(), labelsImg.descr.width, labelsImg.descr.height, labelsImg.descr.components};
+        Overlay::drawText(canvas, static_cast<int>(textX), static_cast<int>(labelH*i + textY), labelText, letterH, labelColor);
 
         ++i;
     }
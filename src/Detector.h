@@ -20,15 +20,14 @@
 #include <vector>
 #include <set>
 #include <unordered_map>
+#include <memory>
 #include "Frame.h"
 #include "Config.h"
-
-struct network;
-
-struct DetectionBox
-{
-    float x, y, w, h;
-};
+#include "BoxUtils.h"
+#include "InferenceBatcher.h"
+#include "Cascade.h"
+#include "Letterbox.h"
+#include "ResultCache.h"
 
 struct DetectionResult
 {
@@ -47,7 +46,11 @@ public:
     };
 
     Detector(const Config& cfg);
-    ~Detector();
+    ///
+    /// \param batcher - shared by detectors of several cameras, their inputs are predicted together
+    /// \param cascade - optional second stage confirming uncertain results
+    ///
+    Detector(const Config& cfg, const std::shared_ptr<InferenceBatcher>& batcher, const std::shared_ptr<Cascade>& cascade = nullptr);
 
     ///
     /// \param data   - image pixels, data is copied to cache
@@ -55,15 +58,41 @@ public:
     /// \param height - image height
     /// \param components - image component of pixel, one component equal one byte, e.g. 1 - R, 2 - RG, 3 - RGB, 4 - RGBA
     ///                     darknet expects RGB so if input is different then last channel is copied or removed
+    /// \param regions - optional areas of interest (relative), e.g. movement - detection runs on crops around them
     ///
-    void setInput(const FrameU8& frame, const FrameDescr& descr);
+    void setInput(const FrameU8& frame, const FrameDescr& descr, const std::vector<DetectionBox>& regions = std::vector<DetectionBox>());
+
+    ///
+    /// \brief setBurstFrames - other frames of the same event (after setInput, the same description), they are predicted
+    ///                         in batches together with input frame. Detections are grouped across frames into tracks
+    ///                         and track is reported when it is seen in enough frames or once with high probability.
+    ///
+    void setBurstFrames(std::vector<FrameU8>&& frames);
 
     ///
     /// \return true - if find something, false - if find nothing
     ///
     bool detect();
 
+    // detect() split into stages, so pipeline can preprocess next input while network computes the current one
+    bool prepare(); // slices of input copied to network input, false - no network
+    void infer();   // network pass, raw detections of slices
+    bool finish();  // merged results, true - if find something
+
+    ///
+    /// \brief reuseResults - instead of prepare(), results of previous inference of the same scene become results
+    ///                       of current input, infer() and finish() don't compute anything
+    ///
+    void reuseResults(const std::vector<ResultCache::Result>& results);
+
     const std::vector<DetectionResult>& lastResults() const { return m_lastDetections; }
+
+    ///
+    /// \brief inspectedRegions - relative parts of input frame the last detection looked at: its slices,
+    ///                           or input regions when results were reused. Objects outside them were not searched for.
+    ///
+    std::vector<DetectionBox> inspectedRegions() const;
+
     const Image& getNetOutImg();
     const Image& getLabeledInImg();
     const Image& getInImg() const { return m_inImage; }
@@ -71,27 +100,87 @@ public:
     void drawResults(std::vector<uint8_t>& data, uint32_t w, uint32_t h, uint32_t c);
 
 protected:
+    // part of input frame placed in one batch item of network input
+    struct Slice {
+        uint32_t cropX, cropY, cropW, cropH; // [px] in input frame
+        uint32_t netX, netY, netW, netH;     // [px] placement of scaled crop in network input
+        uint32_t frame = 0;                  // 0 - input frame, i - m_burstFrames[i-1]
+    };
 
-    void drawResults(std::vector<uint8_t>& data, uint32_t w, uint32_t h, uint32_t c, uint32_t imgX, uint32_t imgY, uint32_t validAreaW, uint32_t validAreaH);
+    ///
+    /// \brief setSharedInput - like setInput, but frame of outer detector is read in place (it has to stay unchanged until detect() returns).
+    ///                         Second stage of cascade reads only crops of the frame, so copying the whole frame is not worth it.
+    ///
+    void setSharedInput(const Detector& outer, const std::vector<DetectionBox>& regions);
+    const FrameU8& inFrame() const { return m_sharedFrame ? *m_sharedFrame : m_inImage.frame; }
+
+    void drawResults(std::vector<uint8_t>& data, uint32_t w, uint32_t h, uint32_t c, int imgX, int imgY, float validAreaW, float validAreaH);
     void readLabels(const std::string& labelsFilePath, const std::string& expectedLabelsFilePath);
     void generateLabelsImg() const;
-
-    network* m_net = nullptr;
-    std::vector<float> m_netInput;
+    void prepareClassFilter(const Config& cfg);
+
+    void prepareSlices();
+    bool prepareTiles();
+    Slice makeSlice(uint32_t cropX, uint32_t cropY, uint32_t cropW, uint32_t cropH) const;
+    void fillNetInput(const Slice& slice, float* netInput);
+    const Letterbox& getLetterbox(const Letterbox::Geometry& geometry);
+    void collectDetections(InferenceBackend& backend, uint32_t batchIdx, const Slice& slice);
+    void mergeResults();
+    void removeDuplicates();
+    void voteBurst();
+    void confirmResults(double firstStageTime);
+
+    std::shared_ptr<InferenceBatcher> m_batcher;
+    const InferenceBackend* m_backend = nullptr; // owned by m_batcher, only for network dimensions
+    std::vector<float> m_netInput; // m_maxBatch network inputs one after another
 
     float m_netThreshold = 0.1f;
+    float m_nmsIou = 0.45f;          // darknet NMS in every slice and duplicates between slices, 0 - no NMS in slice
     std::vector<std::string> m_labels;
     std::unordered_map<uint32_t, uint32_t> m_expectedLabelColors;
+    std::vector<uint32_t> m_expectedClasses; // ids of reported classes
+    std::vector<float> m_classThresholds;    // indexed by class id
+    float m_minClassThreshold = 0.1f;        // threshold passed to darknet
+
+    uint32_t m_maxBatch = 1;
+    bool m_cropRegions = true;
+    float m_cropPadding = 0.25f; // relative to region size, added on every side
+    float m_cropMaxArea = 0.6f;  // relative to frame area, if crops cover more then whole frame is taken
+    bool m_tiling = false;       // overlapping tiles near native scale, for frames much bigger than network input
+    uint32_t m_tileSize = 0;     // [px] of frame, 0 - network input size
+    float m_tileOverlap = 0.2f;  // relative to tile size
+    bool m_tileMotionOnly = true;
+    float m_tileMergeOverlap = 0.6f; // part of smaller box covered by other one, to merge box cut by tile border
+    uint32_t m_burstMinVotes = 2;        // frames in which track is seen
+    float m_burstAcceptProbability = 0.7f; // track seen in fewer frames is reported when its best detection is that sure
+    float m_burstMatchIou = 0.3f;        // of detections of the same object in different frames
+    std::vector<DetectionBox> m_regions;
+    std::vector<FrameU8> m_burstFrames;
+    std::vector<Slice> m_slices;
+    static constexpr size_t LETTERBOX_CACHE_SIZE = 8;
+    std::vector<std::unique_ptr<Letterbox>> m_letterboxes; // preprocessing tables, most recently used first
 
     bool m_outNetImageHasLabels;
-    uint32_t m_netScaledImageX;
-    uint32_t m_netScaledImageY;
-    uint32_t m_netScaledImageW;
-    uint32_t m_netScaledImageH;
     Image m_outNetImage;
 
     bool m_inImageHasLabels;
     Image m_inImage;
-
+    const FrameU8* m_sharedFrame = nullptr; // set by setSharedInput - pixels of input frame instead of m_inImage.frame
+
+    InferenceBackend::Detections m_rawDetections; // of one slice
+    std::vector<DetectionResult> m_sliceDetections;
+    std::vector<bool> m_sliceTruncated; // detection touches slice border inside the frame - object can be cut
+    std::vector<uint32_t> m_sliceFrames; // frame of detection
+    // results are reused between calls, so detection doesn't allocate once they grow
+    static constexpr size_t RESULTS_RESERVE = 256;
+    std::vector<size_t> m_mergeOrder;
+    std::vector<bool> m_keptTruncated;
+    std::vector<uint32_t> m_keptFrames;
     std::vector<DetectionResult> m_lastDetections;
+
+    std::shared_ptr<Cascade> m_cascade;
+    std::unique_ptr<Detector> m_confirmDetector; // second stage, its input are crops around m_confirmRegions
+    std::vector<DetectionBox> m_confirmRegions;
+    std::vector<size_t> m_confirmCandidates;     // indexes in m_lastDetections
+    std::vector<DetectionResult> m_confirmedResults; // swapped with m_lastDetections
 };
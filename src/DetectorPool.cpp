@@ -0,0 +1,505 @@
+//
+// The MIT License (MIT)
+//
+// Copyright 2020 Karolpg
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), 
+// to deal in the Software without restriction, including without limitation the rights to #use, copy, modify, merge, publish, distribute, sublicense, 
+// and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR #COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, 
+// WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+
+#include "DetectorPool.h"
+#include "DirUtils.h"
+
+#include <algorithm>
+#include <cctype>
+#include <iostream>
+#include <assert.h>
+
+namespace {
+
+uint32_t stageQueueSize(const Config& cfg)
+{
+    return std::max(1u, cfg.getValue("detectorStageQueueSize", 1u));
+}
+
+// more workers than networks let batcher join inputs of several jobs
+uint32_t inferenceWorkers(const Config& cfg)
+{
+    return std::max(1u, cfg.getValue("detectorWorkers", std::max(1u, cfg.getValue("detectorNetworks", 1u))));
+}
+
+uint32_t prepareThreads(const Config& cfg)
+{
+    return std::max(1u, cfg.getValue("detectorPrepareThreads", 1u));
+}
+
+uint32_t postThreads(const Config& cfg)
+{
+    return std::max(1u, cfg.getValue("detectorPostThreads", 1u));
+}
+
+// enough detectors to keep every thread and queue slot busy
+uint32_t pipelineDetectors(const Config& cfg)
+{
+    return prepareThreads(cfg) + inferenceWorkers(cfg) + postThreads(cfg) + 2 * stageQueueSize(cfg);
+}
+
+} // namespace
+
+DetectorPool::DetectorPool(const Config& cfg)
+    : m_queueSize(std::max(1u, cfg.getValue("detectorQueueSize", 2u)))
+    , m_reloadCheckInterval(cfg.getValue("detectorReloadCheckInterval", 5.0))
+    , m_statsInterval(cfg.getValue("detectorStatsInterval", 60.0))
+    , m_inferQueue(stageQueueSize(cfg))
+    , m_postQueue(stageQueueSize(cfg))
+    , m_startTime(std::chrono::steady_clock::now())
+{
+    const uint32_t preparing = prepareThreads(cfg);
+    const uint32_t workers = inferenceWorkers(cfg);
+    const uint32_t posting = postThreads(cfg);
+    for (uint32_t t = 0; t < preparing; ++t) {
+        m_threads.emplace_back([this] () { prepareLoop(); });
+    }
+    for (uint32_t t = 0; t < workers; ++t) {
+        m_threads.emplace_back([this] () { inferLoop(); });
+    }
+    for (uint32_t t = 0; t < posting; ++t) {
+        m_threads.emplace_back([this] () { postLoop(); });
+    }
+    std::cout << "DetectorPool: " << preparing << " preprocessing, " << workers << " inference, " << posting << " post-processing threads\n";
+
+    if (m_statsInterval > 0.0) {
+        m_statsDumper = std::thread([this] () { statsLoop(); });
+    }
+
+    // the first model is loaded like reloaded one - cameras and subscribers are set up meanwhile,
+    // jobs wait in source queues until it is loaded and warmed up
+    reload(cfg);
+}
+
+DetectorPool::~DetectorPool()
+{
+    std::shared_ptr<Model> model;
+    {
+        const std::lock_guard<std::mutex> lg(m_mutex);
+        m_stop = true;
+        model = m_model;
+    }
+    m_jobCv.notify_all();
+    m_stopCv.notify_all();
+    if (model) {
+        model->freeDetectors.close();
+    }
+    m_inferQueue.close();
+    m_postQueue.close();
+    for (std::thread& thread : m_threads) {
+        thread.join();
+    }
+    if (m_watcher.joinable()) {
+        m_watcher.join();
+    }
+    if (m_statsDumper.joinable()) {
+        m_statsDumper.join();
+    }
+    if (m_loader.joinable()) {
+        m_loader.join(); // finishes model which is loading now
+    }
+}
+
+std::shared_ptr<DetectorPool::Model> DetectorPool::loadModel(const Config& cfg)
+{
+    auto model = std::make_shared<Model>(pipelineDetectors(cfg));
+    model->batcher = std::make_shared<InferenceBatcher>(cfg);
+    model->resultCache = std::make_unique<ResultCache>(cfg);
+    if (!model->isValid()) {
+        return model;
+    }
+    if (cfg.getValue("detectorCascade", 0) != 0) {
+        model->cascade = std::make_shared<Cascade>(cfg);
+        if (!model->cascade->isValid()) {
+            model->cascade.reset();
+        }
+    }
+
+    const uint32_t detectors = pipelineDetectors(cfg);
+    for (uint32_t d = 0; d < detectors; ++d) {
+        model->detectors.push_back(std::make_unique<Detector>(cfg, model->batcher, model->cascade));
+        model->freeDetectors.push(model->detectors.back().get());
+    }
+    return model;
+}
+
+std::shared_ptr<DetectorPool::Model> DetectorPool::currentModel() const
+{
+    const std::lock_guard<std::mutex> lg(m_mutex);
+    return m_model;
+}
+
+bool DetectorPool::isValid() const
+{
+    std::shared_ptr<Model> model = currentModel();
+    return model && model->isValid();
+}
+
+InferenceBatcher::Metrics DetectorPool::getBatchMetrics() const
+{
+    std::shared_ptr<Model> model = currentModel();
+    return model ? model->batcher->getMetrics() : InferenceBatcher::Metrics();
+}
+
+bool DetectorPool::hasCascade() const
+{
+    std::shared_ptr<Model> model = currentModel();
+    return model && model->cascade;
+}
+
+Cascade::Metrics DetectorPool::getCascadeMetrics() const
+{
+    std::shared_ptr<Model> model = currentModel();
+    return model && model->cascade ? model->cascade->getMetrics() : Cascade::Metrics();
+}
+
+ResultCache::Metrics DetectorPool::getResultCacheMetrics() const
+{
+    std::shared_ptr<Model> model = currentModel();
+    return model ? model->resultCache->getMetrics() : ResultCache::Metrics();
+}
+
+void DetectorPool::reload(const Config& cfg)
+{
+    const std::lock_guard<std::mutex> lg(m_mutex);
+    if (m_stop) {
+        return;
+    }
+    m_reloadConfig = std::make_unique<Config>(cfg); // replaces older request which is not loading yet
+    if (!m_loading) {
+        m_loading = true;
+        if (m_loader.joinable()) {
+            m_loader.join(); // previous loader has already finished
+        }
+        m_loader = std::thread([this] () { loaderLoop(); });
+    }
+}
+
+void DetectorPool::watchFiles(const std::string& configFilePath)
+{
+    if (m_reloadCheckInterval <= 0.0 || m_watcher.joinable()) {
+        return;
+    }
+    m_watcher = std::thread([this, configFilePath] () { watcherLoop(configFilePath); });
+}
+
+void DetectorPool::submit(Job&& job)
+{
+    {
+        const std::lock_guard<std::mutex> lg(m_mutex);
+        if (!m_model && !m_loading) {
+            return; // the first model couldn't be loaded
+        }
+        auto it = findSource(job.source);
+        if (it == m_sources.end()) {
+            m_sources.push_back(SourceQueue{job.source, {}, 0});
+            it = m_sources.end() - 1;
+        }
+        if (it->jobs.size() >= m_queueSize) {
+            // the newest frame is more interesting than the oldest one
+            it->jobs.pop_front();
+            m_stats.count(DetectionStats::Dropped);
+            ++m_metrics.dropped;
+            --m_metrics.queueDepth;
+        }
+        it->jobs.push_back(Queued{std::move(job), std::chrono::steady_clock::now()});
+        m_stats.count(DetectionStats::Triggers);
+        ++m_metrics.queueDepth;
+        m_metrics.maxQueueDepth = std::max(m_metrics.maxQueueDepth, m_metrics.queueDepth);
+    }
+    m_jobCv.notify_one();
+}
+
+void DetectorPool::removeSource(const void* source)
+{
+    std::unique_lock<std::mutex> ul(m_mutex);
+    auto it = findSource(source);
+    if (it == m_sources.end()) {
+        return;
+    }
+    m_metrics.queueDepth -= static_cast<uint32_t>(it->jobs.size());
+    it->jobs.clear();
+    m_doneCv.wait(ul, [this, source] { return findSource(source)->running == 0; });
+    m_sources.erase(findSource(source));
+    m_nextSource = 0;
+    if (m_model) {
+        m_model->resultCache->removeSource(source); // address can be reused by new source
+    }
+}
+
+DetectorPool::Metrics DetectorPool::getMetrics() const
+{
+    Metrics metrics;
+    {
+        const std::lock_guard<std::mutex> lg(m_mutex);
+        metrics = m_metrics;
+    }
+    metrics.inferQueueDepth = static_cast<uint32_t>(m_inferQueue.size());
+    metrics.postQueueDepth = static_cast<uint32_t>(m_postQueue.size());
+    return metrics;
+}
+
+std::vector<DetectorPool::SourceQueue>::iterator DetectorPool::findSource(const void* source)
+{
+    return std::find_if(m_sources.begin(), m_sources.end(), [source] (const SourceQueue& sq) { return sq.source == source; });
+}
+
+void DetectorPool::prepareLoop()
+{
+    std::vector<ResultCache::Result> cachedResults;
+    while (true) {
+        // detector first - job is taken as late as possible, so newer frame can replace it in source queue
+        std::shared_ptr<Model> model;
+        {
+            std::unique_lock<std::mutex> ul(m_mutex);
+            m_jobCv.wait(ul, [this] { return m_stop || m_model; }); // the first model is loading
+            if (m_stop) {
+                break;
+            }
+            model = m_model;
+        }
+        Detector* detector = nullptr;
+        if (!model->freeDetectors.pop(detector)) {
+            const std::lock_guard<std::mutex> lg(m_mutex);
+            if (m_stop) {
+                break;
+            }
+            continue; // model was replaced
+        }
+
+        std::unique_lock<std::mutex> ul(m_mutex);
+        m_jobCv.wait(ul, [this] { return m_stop || m_metrics.queueDepth > 0; });
+        if (m_stop) {
+            break;
+        }
+        if (model != m_model) {
+            continue; // replaced while waiting for job - detector of old model is not used anymore
+        }
+
+        // round robin - the first source with waiting job, starting after previously served one
+        size_t sourceIdx = 0;
+        for (size_t i = 0; i < m_sources.size(); ++i) {
+            size_t idx = (m_nextSource + i) % m_sources.size();
+            if (!m_sources[idx].jobs.empty()) {
+                sourceIdx = idx;
+                break;
+            }
+        }
+        SourceQueue& sq = m_sources[sourceIdx];
+        assert(!sq.jobs.empty());
+        Queued queued = std::move(sq.jobs.front());
+        sq.jobs.pop_front();
+        ++sq.running;
+        const void* source = sq.source;
+        m_nextSource = sourceIdx + 1;
+
+        auto beginPrepare = std::chrono::steady_clock::now();
+        m_stats.record(DetectionStats::TriggerWait, beginPrepare - queued.queueTime);
+        std::chrono::duration<double> wait = beginPrepare - queued.queueTime;
+        Metrics& m = m_metrics;
+        --m.queueDepth;
+        ++m.runningJobs;
+        m.averageWait = m.processed == 0 ? wait.count() : m.averageWait + (wait.count() - m.averageWait) * METRICS_SMOOTHING;
+        m.lastWait = wait.count();
+        ul.unlock();
+
+        InFlight inFlight{detector, std::move(model), source, std::move(queued.job.onDetected), {}, false};
+        ResultCache& cache = *inFlight.model->resultCache;
+        detector->setInput(queued.job.frame, queued.job.descr, queued.job.regions);
+        detector->setBurstFrames(std::move(queued.job.burst));
+        if (cache.isEnabled()) {
+            inFlight.cacheKey = ResultCache::makeKey(queued.job.frame, queued.job.descr, queued.job.regions);
+            inFlight.reused = cache.find(source, inFlight.cacheKey, beginPrepare, cachedResults);
+        }
+        if (inFlight.reused) {
+            detector->reuseResults(cachedResults);
+            m_stats.count(DetectionStats::Reused);
+        }
+        else {
+            detector->prepare();
+            m_stats.record(DetectionStats::Preprocessing, std::chrono::steady_clock::now() - beginPrepare);
+        }
+        if (!m_inferQueue.push(std::move(inFlight))) {
+            break;
+        }
+    }
+}
+
+void DetectorPool::inferLoop()
+{
+    while (true) {
+        InFlight inFlight;
+        if (!m_inferQueue.pop(inFlight)) {
+            break;
+        }
+        if (!inFlight.reused) {
+            auto beginInfer = std::chrono::steady_clock::now();
+            inFlight.detector->infer();
+            m_stats.record(DetectionStats::Predict, std::chrono::steady_clock::now() - beginInfer);
+        }
+        if (!m_postQueue.push(std::move(inFlight))) {
+            break;
+        }
+    }
+}
+
+void DetectorPool::postLoop()
+{
+    while (true) {
+        InFlight inFlight;
+        if (!m_postQueue.pop(inFlight)) {
+            break;
+        }
+        if (!inFlight.reused) {
+            auto beginFinish = std::chrono::steady_clock::now();
+            inFlight.detector->finish();
+            m_stats.record(DetectionStats::BoxExtraction, std::chrono::steady_clock::now() - beginFinish);
+
+            ResultCache& cache = *inFlight.model->resultCache;
+            if (cache.isEnabled()) {
+                std::vector<ResultCache::Result> results;
+                for (const DetectionResult& dr : inFlight.detector->lastResults()) {
+                    results.push_back({dr.classId, dr.probablity, dr.box});
+                }
+                cache.store(inFlight.source, std::move(inFlight.cacheKey), beginFinish, std::move(results));
+            }
+        }
+        if (inFlight.onDetected) {
+            inFlight.onDetected(*inFlight.detector);
+        }
+        inFlight.model->freeDetectors.push(std::move(inFlight.detector)); // fails for replaced model
+
+        const std::lock_guard<std::mutex> lg(m_mutex);
+        --m_metrics.runningJobs;
+        ++m_metrics.processed;
+        if (m_metrics.processed == 1) {
+            std::chrono::duration<double> sinceStart = std::chrono::steady_clock::now() - m_startTime;
+            std::cout << "DetectorPool: first detection " << sinceStart.count() << "[s] after start\n";
+        }
+        // sources can be reordered by removeSource, find it again
+        auto it = findSource(inFlight.source);
+        assert(it != m_sources.end());
+        --it->running;
+        m_doneCv.notify_all();
+    }
+}
+
+void DetectorPool::loaderLoop()
+{
+    while (true) {
+        std::unique_ptr<Config> cfg;
+        {
+            const std::lock_guard<std::mutex> lg(m_mutex);
+            if (m_stop || !m_reloadConfig) {
+                m_loading = false;
+                if (!m_model) {
+                    // nothing will process them
+                    for (SourceQueue& sq : m_sources) {
+                        m_metrics.queueDepth -= static_cast<uint32_t>(sq.jobs.size());
+                        sq.jobs.clear();
+                    }
+                }
+                return;
+            }
+            cfg = std::move(m_reloadConfig);
+        }
+
+        auto beginLoad = std::chrono::steady_clock::now();
+        std::shared_ptr<Model> model = loadModel(*cfg);
+        if (!model->isValid()) {
+            std::cerr << "DetectorPool: new model can't be loaded" << (currentModel() ? ", the current one is kept\n" : "\n");
+            continue;
+        }
+        model->batcher->warmUp();
+        if (model->cascade) {
+            model->cascade->batcher()->warmUp();
+        }
+
+        {
+            // between jobs - the next job is prepared by new model, running ones finish with the old one
+            const std::lock_guard<std::mutex> lg(m_mutex);
+            m_model.swap(model);
+        }
+        m_jobCv.notify_all(); // preprocessing threads waiting for the first model
+        const bool first = !model;
+        if (model) {
+            model->freeDetectors.close(); // old model, freed by its last job (or here)
+            model.reset();
+        }
+
+        std::chrono::duration<double> loadTime = std::chrono::steady_clock::now() - beginLoad;
+        std::cout << "DetectorPool: model " << (first ? "loaded" : "reloaded") << " and warmed up in " << loadTime.count() << "[s]\n";
+    }
+}
+
+void DetectorPool::statsLoop()
+{
+    const auto interval = std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(m_statsInterval));
+    std::unique_lock<std::mutex> ul(m_mutex);
+    while (!m_stopCv.wait_for(ul, interval, [this] { return m_stop; })) {
+        ul.unlock();
+        std::cout << "DetectorPool stats:\n" + m_stats.snapshot().toString();
+        std::cout.flush();
+        ul.lock();
+    }
+}
+
+void DetectorPool::watcherLoop(std::string configFilePath)
+{
+    // model files are taken from the newest config, cascade ones too
+    auto watchedFiles = [&configFilePath] (const Config& cfg) {
+        std::vector<std::string> files{configFilePath};
+        for (const char* key : {"darknetCfgFilePath", "darknetWeightsFilePath", "darknetOutLabelsFilePath", "validLabelsFilePath"}) {
+            files.push_back(cfg.getValue(key));
+            files.push_back(cfg.getValue(std::string("cascade") + static_cast<char>(std::toupper(key[0])) + (key + 1)));
+        }
+        return files;
+    };
+    auto signature = [] (const std::vector<std::string>& files) {
+        std::vector<int64_t> times;
+        for (const std::string& file : files) {
+            times.push_back(file.empty() ? 0 : DirUtils::modificationTime(file));
+        }
+        return times;
+    };
+
+    Config cfg;
+    cfg.insertFromFile(configFilePath);
+    int64_t cfgTime = DirUtils::modificationTime(configFilePath);
+    std::vector<int64_t> loaded = signature(watchedFiles(cfg));
+    std::vector<int64_t> previous = loaded;
+    const auto interval = std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(m_reloadCheckInterval));
+
+    std::unique_lock<std::mutex> ul(m_mutex);
+    while (!m_stopCv.wait_for(ul, interval, [this] { return m_stop; })) {
+        ul.unlock();
+        if (DirUtils::modificationTime(configFilePath) != cfgTime) {
+            // config can point to other model files
+            cfg = Config();
+            cfgTime = DirUtils::modificationTime(configFilePath);
+            cfg.insertFromFile(configFilePath);
+        }
+        std::vector<int64_t> current = signature(watchedFiles(cfg));
+        // reload when files are changed and not being written anymore
+        if (current != loaded && current == previous) {
+            std::cout << "DetectorPool: model files changed, reloading\n";
+            reload(cfg);
+            loaded = current;
+        }
+        previous = current;
+        ul.lock();
+    }
+}
@@ -0,0 +1,181 @@
+//
+// The MIT License (MIT)
+//
+// Copyright 2020 Karolpg
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), 
+// to deal in the Software without restriction, including without limitation the rights to #use, copy, modify, merge, publish, distribute, sublicense, 
+// and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR #COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, 
+// WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+
+#pragma once
+
+#include <vector>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+#include <functional>
+#include <chrono>
+#include "Config.h"
+#include "Detector.h"
+#include "InferenceBatcher.h"
+#include "BoundedQueue.h"
+#include "DetectionStats.h"
+
+///
+/// \brief The DetectorPool class - detection pipeline sharing network instances of one InferenceBatcher.
+///                                 Jobs wait in bounded queue per source (camera) and sources are served round robin,
+///                                 so busy camera can't starve others. When source queue is full its oldest job is dropped.
+///                                 Job goes through stages connected by small bounded queues: preprocessing (network input),
+///                                 inference (worker threads) and post-processing (merging results, onDetected),
+///                                 so next input is prepared and previous results are handled while network computes.
+///                                 Every job in flight has own Detector taken from free ones.
+///                                 Job whose regions look like regions of recent inference of its source reuses its results
+///                                 (ResultCache) - it skips preprocessing and inference.
+///                                 The first model is loaded in background too, submitted jobs wait until it is warmed up.
+///                                 Model (networks, thresholds, labels) can be reloaded without stopping the pipeline:
+///                                 new one is loaded and warmed up in background, then swapped in between jobs,
+///                                 the old one is freed when its last running job is finished.
+///
+class DetectorPool
+{
+public:
+    struct Job {
+        const void* source = nullptr; // e.g. FrameController
+        FrameU8 frame;
+        FrameDescr descr;
+        std::vector<DetectionBox> regions;
+        std::vector<FrameU8> burst; // optional other frames of the event, results of all frames are voted
+        std::function<void(Detector& detector)> onDetected; // called by post-processing thread, with results in detector
+    };
+
+    struct Metrics {
+        uint32_t queueDepth = 0;      // jobs waiting now
+        uint32_t maxQueueDepth = 0;
+        uint32_t runningJobs = 0;     // taken from queue, in one of stages
+        uint32_t inferQueueDepth = 0; // prepared, waiting for inference worker
+        uint32_t postQueueDepth = 0;  // inferred, waiting for post-processing
+        uint64_t processed = 0;
+        uint64_t dropped = 0;         // replaced by newer job of the same source
+        double averageWait = 0.0;     // [s] time in queue
+        double lastWait = 0.0;        // [s]
+    };
+
+    DetectorPool(const Config& cfg);
+    ~DetectorPool();
+
+    // false also while the first model is loading
+    bool isValid() const;
+
+    void submit(Job&& job);
+
+    ///
+    /// \brief removeSource - drops queued jobs of source and waits until its running jobs are finished
+    ///
+    void removeSource(const void* source);
+
+    ///
+    /// \brief reload - loads model described by cfg in background and swaps it in when ready,
+    ///                 if loading fails the current model stays. Thread counts and queue sizes are not changed.
+    ///
+    void reload(const Config& cfg);
+
+    ///
+    /// \brief watchFiles - reloads model when config file or model files given in it (networks, labels) change
+    ///                     and stay unchanged for "detectorReloadCheckInterval" seconds
+    ///
+    void watchFiles(const std::string& configFilePath);
+
+    Metrics getMetrics() const;
+    // of current model - counted from its load
+    InferenceBatcher::Metrics getBatchMetrics() const;
+    bool hasCascade() const;
+    Cascade::Metrics getCascadeMetrics() const;
+    ResultCache::Metrics getResultCacheMetrics() const;
+
+    ///
+    /// \brief stats - latency histograms of detection stages, also dumped every "detectorStatsInterval" seconds.
+    ///               Stages after post-processing (drawing, notify) are recorded by job owners.
+    ///
+    DetectionStats& stats() { return m_stats; }
+    DetectionStats::Snapshot getStats() const { return m_stats.snapshot(); }
+
+private:
+    struct Model {
+        explicit Model(uint32_t detectorsCount) : freeDetectors(detectorsCount) {}
+        bool isValid() const { return batcher->isValid(); }
+
+        std::shared_ptr<InferenceBatcher> batcher;
+        std::shared_ptr<Cascade> cascade; // optional second stage
+        std::unique_ptr<ResultCache> resultCache; // results depend on model - cleared with it
+        std::vector<std::unique_ptr<Detector>> detectors; // one per job in flight
+        BoundedQueue<Detector*> freeDetectors; // closed when model is replaced
+    };
+
+    struct InFlight {
+        Detector* detector = nullptr;
+        std::shared_ptr<Model> model; // keeps replaced model until its jobs are finished
+        const void* source = nullptr;
+        std::function<void(Detector& detector)> onDetected;
+        ResultCache::Key cacheKey;
+        bool reused = false; // results from cache
+    };
+
+    struct Queued {
+        Job job;
+        std::chrono::steady_clock::time_point queueTime;
+    };
+
+    struct SourceQueue {
+        const void* source;
+        std::deque<Queued> jobs;
+        uint32_t running = 0;
+    };
+
+    static std::shared_ptr<Model> loadModel(const Config& cfg);
+    std::shared_ptr<Model> currentModel() const;
+
+    void prepareLoop();
+    void inferLoop();
+    void postLoop();
+    void loaderLoop();
+    void watcherLoop(std::string configFilePath);
+    void statsLoop();
+    std::vector<SourceQueue>::iterator findSource(const void* source); // under m_mutex
+
+    std::shared_ptr<Model> m_model; // under m_mutex, null until the first one is loaded
+    uint32_t m_queueSize; // per source
+    double m_reloadCheckInterval; // [s]
+    double m_statsInterval;       // [s]
+
+    BoundedQueue<InFlight> m_inferQueue;
+    BoundedQueue<InFlight> m_postQueue;
+    std::vector<std::thread> m_threads; // all stages
+    std::chrono::steady_clock::time_point m_startTime; // for time to the first detection
+
+    std::thread m_loader;
+    std::unique_ptr<Config> m_reloadConfig; // newest requested, under m_mutex
+    bool m_loading = false;                 // under m_mutex
+    std::thread m_watcher;
+    std::thread m_statsDumper;
+    std::condition_variable m_stopCv;       // wakes up watcher and stats dumper
+
+    mutable std::mutex m_mutex;
+    std::condition_variable m_jobCv;  // new job or stop
+    std::condition_variable m_doneCv; // job finished
+    std::vector<SourceQueue> m_sources;
+    size_t m_nextSource = 0; // round robin position
+    bool m_stop = false;
+    Metrics m_metrics;
+    DetectionStats m_stats;
+
+    static constexpr double METRICS_SMOOTHING = 0.1; // weight of newest sample in averages
+};
@@ -73,6 +73,16 @@ bool isFile(const std::string& filepath)
     return (info.st_mode & S_IFREG) != 0; // REG == regular file
 }
 
+int64_t modificationTime(const std::string& filePath)
+{
+    struct stat info;
+    if (stat(filePath.c_str(), &info) != 0)
+    {
+        return 0;
+    }
+    return static_cast<int64_t>(info.st_mtim.tv_sec) * 1000000000 + info.st_mtim.tv_nsec;
+}
+
 bool makePath(const std::string &path, uint32_t mode)
 {
     if (path.empty()) {
@@ -18,6 +18,7 @@
 
 #include <string>
 #include <vector>
+#include <cstdint>
 
 namespace DirUtils {
 
@@ -32,5 +33,8 @@ bool makePath(const std::string& path, uint32_t mode = 0755);
 // #include <filesystem> GCC 8.0 needed
 size_t file_size(const std::string& filePath);
 
+// [ns] since epoch, 0 - file doesn't exist
+int64_t modificationTime(const std::string& filePath);
+
 std::vector<std::string> listDir(const std::string& path);
 } // namespace DirUtils
@@ -54,6 +54,10 @@ static std::string currentDateTime() {
 }
 
 FrameController::FrameController(const Config& cfg)
+    : m_burstFrames(std::max(1u, cfg.getValue("detectorBurstFrames", 1u)))
+    , m_burstPreRoll(cfg.getValue("detectorBurstPreRoll", 0.5))
+    , m_moveAnalyzer(cfg)
+    , m_tracker(cfg)
 {
     m_videoDirectory = DirUtils::cleanPath(cfg.getValue("videoStorePath", "/tmp"));
 
@@ -66,9 +70,6 @@ FrameController::FrameController(const Config& cfg)
     }
     std::cout << "Storing video in: " << m_videoDirectory << "\n";
 
-    m_detectorThread = std::thread([this]{ detectionThreadFunc(); });
-
-
     m_moveAnalyzer.subscribeOnMovementDetected(onMovementDetected, this);
 }
 
@@ -80,9 +81,15 @@ FrameController::~FrameController()
         func(ctx);
     }
 
-    m_detectorThreadIsRunning = false;
-    m_waitForDetectionTask.notify_all();
-    m_detectorThread.join();
+    // movement analysis still runs - stop submitting, then wait for jobs already in the pool
+    std::shared_ptr<DetectorPool> detectorPool;
+    {
+        std::lock_guard<std::mutex> lg(m_detectorPoolMutex);
+        detectorPool.swap(m_detectorPool);
+    }
+    if (detectorPool) {
+        detectorPool->removeSource(this);
+    }
 
     for (;;) {
         std::thread t;
@@ -110,6 +117,7 @@ void FrameController::setBufferParams(double duration, double cameraFps, uint32_
     uint32_t frames = static_cast<uint32_t>(duration*cameraFps);
     frames = std::max(static_cast<uint32_t>(1), frames);
     m_cyclicBuffer.resize(frames);
+    m_slotNr = std::vector<std::atomic<uint64_t>>(frames);
     m_frameDescr.width = width;
     m_frameDescr.height = height;
     m_frameDescr.components = components;
@@ -124,10 +132,17 @@ void FrameController::setBufferParams(double duration, double cameraFps, uint32_
     }
 }
 
-void FrameController::setDetector(const std::shared_ptr<Detector> &detector)
+void FrameController::setDetectorPool(const std::shared_ptr<DetectorPool> &detectorPool)
 {
-    std::lock_guard<std::mutex> lg(m_detectionData.detectionMutex);
-    m_detectionData.detector = detector;
+    std::shared_ptr<DetectorPool> prevPool;
+    {
+        std::lock_guard<std::mutex> lg(m_detectorPoolMutex);
+        prevPool = m_detectorPool;
+        m_detectorPool = detectorPool;
+    }
+    if (prevPool && prevPool != detectorPool) {
+        prevPool->removeSource(this);
+    }
 }
 
 void FrameController::addFrame(const uint8_t* data)
@@ -145,21 +160,26 @@ void FrameController::addFrame(const uint8_t* data)
     //uint64_t prevFrameNr = m_frameCtr;
     //uint32_t prevFrameInBuffer = static_cast<uint32_t>(prevFrameNr % m_cyclicBuffer.size());
 
-    uint64_t frameNr = ++m_frameCtr;
+    uint64_t frameNr = m_frameCtr.load(std::memory_order_relaxed) + 1;
     uint32_t frameInBuffer = static_cast<uint32_t>(frameNr % m_cyclicBuffer.size());
     FrameU8& frame = m_cyclicBuffer[frameInBuffer];
     assert(frameInBuffer == frame.bufferIdx);
 
+    // readers check slot number before and after reading it (see copyFrame)
+    m_slotNr[frameInBuffer].store(0, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
     frame.nr = frameNr;
     frame.time = std::chrono::steady_clock::now();
     std::memcpy(frame.data.data(), data, frame.data.size());
+    m_slotNr[frameInBuffer].store(frameNr, std::memory_order_release);
+    m_frameCtr.store(frameNr, std::memory_order_release);
 
     notifyAboutNewFrame();
     feedRecorder(frame);
     m_moveAnalyzer.feedAnalyzer(frame, m_frameDescr);
 }
 
-void FrameController::onMovementDetected(uint64_t frameNumber, uint32_t bufferIdx, void *ctx)
+void FrameController::onMovementDetected(uint64_t frameNumber, uint32_t bufferIdx, const std::vector<DetectionBox>& regions, void *ctx)
 {
     FrameController& fc = *reinterpret_cast<FrameController*>(ctx);
 
@@ -168,72 +188,138 @@ void FrameController::onMovementDetected(uint64_t frameNumber, uint32_t bufferId
         return;
     }
 
-    if (fc.m_cyclicBuffer[bufferIdx].nr != frameNumber) {
+    if (fc.publishedNr(bufferIdx) != frameNumber) {
         std::cout << "Timeout! Frame: " << frameNumber << " is not in cyclic buffer.\n";
         std::cout.flush();
 
-        uint32_t frameInBuffer = static_cast<uint32_t>(fc.m_frameCtr % fc.m_cyclicBuffer.size());
-        fc.runDetection(fc.m_cyclicBuffer[frameInBuffer]); // run lates frame
+        fc.runDetection(fc.m_frameCtr.load(std::memory_order_acquire), {}); // run lates frame - regions are from other frame so check whole
     }
     else {
-        // hope we not override this frame but here - another solution is carrying copy of frame
-        // I would like to omit it.
-        fc.runDetection(fc.m_cyclicBuffer[bufferIdx]);
+        fc.runDetection(frameNumber, regions);
     }
 
 }
 
-void FrameController::runDetection(const FrameU8 &frame)
+void FrameController::runDetection(uint64_t frameNr, std::vector<DetectionBox> regions)
 {
     //if (!isFrameChanged(m_cyclicBuffer[frameInBuffer], m_cyclicBuffer[prevFrameInBuffer])) {
     //    return;
     //}
 
-    if (!m_detectionData.detectionMutex.try_lock()) {
-        // if detector is processing we just skip this frame
+    const std::lock_guard<std::mutex> lg(m_detectorPoolMutex);
+    if (!m_detectorPool) {
         return;
     }
-    if (!m_detectionData.detector) {
-        // there is no detector, but we have to check it under mutex
-        m_detectionData.detectionMutex.unlock();
+    if (!m_tracker.needsDetection(regions, std::chrono::steady_clock::now())) {
+        // movement of already tracked objects only
+        m_detectorPool->stats().count(DetectionStats::Coalesced);
         return;
     }
-    // if detector is not processing, then data is copied into detector cache
-    m_detectionData.frame = frame.nr;
-    m_detectionData.frameInBuffer = frame.bufferIdx;
-    m_detectionData.detector->setInput(frame, m_frameDescr);
-    m_detectionData.jobIsReady = true;
-    m_waitForDetectionTask.notify_one();
-    m_detectionData.detectionMutex.unlock();
+    // frame is copied - cyclic buffer slot can be overwritten before job leaves the queue
+    DetectorPool::Job job;
+    if (!copyFrame(frameNr, job.frame)) {
+        std::cout << "Timeout! Frame: " << frameNr << " overwritten while copied.\n";
+        frameNr = m_frameCtr.load(std::memory_order_acquire);
+        regions.clear(); // regions are from other frame so check whole
+        if (!copyFrame(frameNr, job.frame)) {
+            return;
+        }
+    }
+    job.source = this;
+    job.descr = m_frameDescr;
+    job.regions = std::move(regions);
+    job.burst = burstFrames(job.frame);
+    // pool outlives its jobs - they are called by its threads
+    job.onDetected = [this, stats = &m_detectorPool->stats(), frameNr, frameInBuffer = job.frame.bufferIdx, start = std::chrono::steady_clock::now()] (Detector& detector) {
+        detect(detector, *stats, frameNr, frameInBuffer, start);
+    };
+    m_detectorPool->submit(std::move(job));
 }
 
-void FrameController::detectionThreadFunc()
+std::vector<FrameU8> FrameController::burstFrames(const FrameU8& frame) const
 {
-    while (m_detectorThreadIsRunning) {
-        {
-            std::unique_lock<std::mutex> ul(m_waitForDetectionTaskMtx);
-            m_waitForDetectionTask.wait(ul, [this] { return m_detectionData.jobIsReady; });
-        }
-        if (!m_detectorThreadIsRunning) {
+    std::vector<FrameU8> burst;
+    if (m_burstFrames <= 1 || m_cyclicBuffer.size() < 3) {
+        return burst;
+    }
+
+    // frames still in buffer from pre-roll to the newest one - the newest slot is being written
+    // and the oldest one is overwritten next
+    const auto preRollStart = frame.time - std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(m_burstPreRoll));
+    std::vector<uint64_t> candidates;
+    const uint64_t newest = m_frameCtr.load(std::memory_order_acquire);
+    for (uint64_t nr = newest; nr > 0 && newest - nr + 1 < m_cyclicBuffer.size(); --nr) {
+        const uint32_t slot = static_cast<uint32_t>(nr % m_cyclicBuffer.size());
+        if (publishedNr(slot) != nr) {
             break;
         }
-        detect();
+        const auto time = m_cyclicBuffer[slot].time;
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (m_slotNr[slot].load(std::memory_order_relaxed) != nr || time < preRollStart) {
+            break; // overwritten while read or too old
+        }
+        if (nr != frame.nr) {
+            candidates.push_back(nr);
+        }
     }
+    std::reverse(candidates.begin(), candidates.end());
+
+    // spread evenly in time
+    const size_t count = std::min<size_t>(m_burstFrames - 1, candidates.size());
+    for (size_t i = 0; i < count; ++i) {
+        FrameU8 f;
+        if (copyFrame(candidates[(2 * i + 1) * candidates.size() / (2 * count)], f)) {
+            burst.push_back(std::move(f));
+        }
+    }
+    return burst;
+}
+
+bool FrameController::copyFrame(uint64_t frameNr, FrameU8& out) const
+{
+    if (frameNr == 0 || m_cyclicBuffer.empty()) {
+        return false;
+    }
+    const uint32_t slot = static_cast<uint32_t>(frameNr % m_cyclicBuffer.size());
+    if (publishedNr(slot) != frameNr) {
+        return false;
+    }
+    out = m_cyclicBuffer[slot];
+    // slot number is still the same - camera thread didn't start overwriting it during copy
+    std::atomic_thread_fence(std::memory_order_acquire);
+    return m_slotNr[slot].load(std::memory_order_relaxed) == frameNr;
 }
 
-void FrameController::detect()
+void FrameController::detect(Detector& detector, DetectionStats& stats, uint64_t frameNr, uint32_t frameInBuffer, const std::chrono::steady_clock::time_point& start)
 {
-    const std::lock_guard<std::mutex> lock(m_detectionData.detectionMutex);
-    m_detectionData.jobIsReady = false;
+    std::cout << "Detected for: " << frameNr << "(" << frameInBuffer << ")\n";
+    bool detected = !detector.lastResults().empty();
+    std::string tracksInfo;
+    if (m_tracker.isEnabled()) {
+        ObjectTracker::Changes changes = m_tracker.update(detector.lastResults(), detector.inspectedRegions(), std::chrono::steady_clock::now());
+        if (changes.newTracks.empty() && changes.lostTracks.empty() && !changes.keptTracks.empty()) {
+            std::chrono::duration<double> detectTime = std::chrono::steady_clock::now() - start;
+            std::cout << "Only tracked objects found. Detection time: " << detectTime.count() << "[s]\n";
+            std::cout.flush();
+            return;
+        }
+        std::stringstream ss;
+        for (const ObjectTracker::Track& t : changes.newTracks) {
+            ss << "New track: #" << t.id << " " << t.label << "\n";
+        }
+        for (const ObjectTracker::Track& t : changes.lostTracks) {
+            ss << "Lost track: #" << t.id << " " << t.label << "\n";
+        }
+        tracksInfo = ss.str();
+    }
 
-    std::cout << "Detecting for: " << m_detectionData.frame << "(" << m_detectionData.frameInBuffer << ")\n";
-    auto start = std::chrono::steady_clock::now();
-    if (m_detectionData.detector->detect()) {
+    if (detected) {
         std::chrono::duration<double> detectTime = std::chrono::steady_clock::now() - start;
         std::cout << "Detection time: " << detectTime.count() << "[s]\n";
 
-        const auto& results = m_detectionData.detector->lastResults();
+        const auto& results = detector.lastResults();
         std::stringstream ss;
+        ss << tracksInfo;
         std::set<std::string> labels;
         for (const DetectionResult& dr : results) {
             labels.insert(dr.label);
@@ -261,11 +347,15 @@ void FrameController::detect()
         //PngTools::writePngFile((std::string("/tmp/detectionResult") + std::to_string(frameNr) + "_.png").c_str(),
         //                       detectedinImg.w, detectedinImg.h, detectedinImg.c, detectedinImg.data.data());
         //
-        auto detectedOutImg = m_detectionData.detector->getLabeledInImg();
+        auto beginDrawing = std::chrono::steady_clock::now();
+        auto detectedOutImg = detector.getLabeledInImg();
+        auto beginPng = std::chrono::steady_clock::now();
+        stats.record(DetectionStats::Drawing, beginPng - beginDrawing);
         PngTools::writePngFile(detectedFrameFilePath.c_str(),
                                detectedOutImg.descr.width, detectedOutImg.descr.height, detectedOutImg.descr.components, detectedOutImg.frame.data.data());
+        stats.record(DetectionStats::PngEncode, std::chrono::steady_clock::now() - beginPng);
 
-        auto recordingResult = recording(videoFilePath, m_detectionData.frame, m_detectionData.frameInBuffer);
+        auto recordingResult = recording(videoFilePath, frameNr, frameInBuffer, detector.getInImg().frame);
 
         if (recordingResult == StartedNewVideo) {
             info += "Detection trigger storing video on: " + videoFilePath;
@@ -273,7 +363,9 @@ void FrameController::detect()
         else {
             info += "continue previous video";
         }
+        auto beginNotify = std::chrono::steady_clock::now();
         notifyAboutDetection(info, detectedOutImg.frame, detectedOutImg.descr);
+        stats.record(DetectionStats::Notify, std::chrono::steady_clock::now() - beginNotify);
     }
     else {
         std::chrono::duration<double> detectTime = std::chrono::steady_clock::now() - start;
@@ -286,20 +378,24 @@ void FrameController::detect()
         std::string detectedFrameFilePath = filePath + ".png";
         //std::string videoFilePath = filePath + ".mpeg";
 
-        auto detectedInImg = m_detectionData.detector->getInImg();
+        auto detectedInImg = detector.getInImg();
+        auto beginPng = std::chrono::steady_clock::now();
         PngTools::writePngFile(detectedFrameFilePath.c_str(),
                                detectedInImg.descr.width, detectedInImg.descr.height, detectedInImg.descr.components, detectedInImg.frame.data.data());
+        stats.record(DetectionStats::PngEncode, std::chrono::steady_clock::now() - beginPng);
 
-        std::string info = "Movement detected without recognition on: " + detectedFrameFilePath;
+        std::string info = tracksInfo + "Movement detected without recognition on: " + detectedFrameFilePath;
         info += "\nProcess mem usage: " + ProcessUtils::humanReadableSize(ProcessUtils::currentProcessSize());
         info += "\n" + ProcessUtils::memoryInfo() + "\n";
         std::cout << info;
+        auto beginNotify = std::chrono::steady_clock::now();
         notifyAboutDetection(info, detectedInImg.frame, detectedInImg.descr);
+        stats.record(DetectionStats::Notify, std::chrono::steady_clock::now() - beginNotify);
     }
     std::cout.flush();
 }
 
-FrameController::RecordingResult FrameController::recording(const std::string& filename, uint64_t frameNr, uint32_t frameInBuffer)
+FrameController::RecordingResult FrameController::recording(const std::string& filename, uint64_t frameNr, uint32_t frameInBuffer, const FrameU8& detectedFrame)
 {
     std::lock_guard<std::mutex> lg(m_recorderMutex);
     if (m_videoRecorder) {
@@ -324,27 +420,28 @@ FrameController::RecordingResult FrameController::recording(const std::string& f
     rdt.videoFpsD = 1;
     m_videoRecorder = std::unique_ptr<VideoRecorder>(new VideoRecorder(filename, rdt));
 
-    if (m_cyclicBuffer[frameInBuffer].nr == frameNr) {
+    if (publishedNr(frameInBuffer) == frameNr) {
         uint32_t findFirst = frameInBuffer;
         for (uint32_t i = 1; i < m_cyclicBuffer.size() - 1; ++i) {
-            uint32_t prevFrame = (frameInBuffer - i)%m_cyclicBuffer.size();
-            if (m_cyclicBuffer[prevFrame].nr != frameNr - i) {
+            uint32_t prevFrame = (frameInBuffer + m_cyclicBuffer.size() - i)%m_cyclicBuffer.size();
+            if (publishedNr(prevFrame) != frameNr - i) {
                 findFirst = (prevFrame + 1)%m_cyclicBuffer.size();
                 break;
             }
         }
         std::cout << "Current: " << frameInBuffer << " first: " << findFirst << "\n";
+        uint32_t added = 0;
         do
         {
             m_videoRecorder->addFrame(m_cyclicBuffer[findFirst].data);
-            ++findFirst;
+            added = findFirst;
+            findFirst = (findFirst + 1)%m_cyclicBuffer.size();
         }
-        while (m_cyclicBuffer[(findFirst-1)%m_cyclicBuffer.size()].nr + 1 == m_cyclicBuffer[findFirst].nr);
+        while (publishedNr(added) + 1 == publishedNr(findFirst));
     }
     else {
         std::cout << "Unsynchronized! Please set longer cyclic buffer!\n";
-        auto detectedinImg = m_detectionData.detector->getInImg();
-        m_videoRecorder->addFrame(detectedinImg.frame.data);
+        m_videoRecorder->addFrame(detectedFrame.data);
     }
     m_stopRecordingTime = std::chrono::steady_clock::now() + std::chrono::seconds(10);
     return StartedNewVideo;
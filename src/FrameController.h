@@ -26,11 +26,13 @@
 #include <thread>
 #include <condition_variable>
 #include <list>
+#include <atomic>
 
-#include "Detector.h"
+#include "DetectorPool.h"
 #include "Frame.h"
 #include "Config.h"
 #include "MovementAnalyzer.h"
+#include "ObjectTracker.h"
 
 class VideoRecorder;
 
@@ -46,7 +48,7 @@ public:
     ~FrameController();
 
     void setBufferParams(double duration, double cameraFps, uint32_t width, uint32_t height, uint32_t components);
-    void setDetector(const std::shared_ptr<Detector>& detector);
+    void setDetectorPool(const std::shared_ptr<DetectorPool>& detectorPool);
 
     void addFrame(const uint8_t* data);
 
@@ -54,6 +56,10 @@ public:
     uint32_t getHeight() const { return m_frameDescr.height; }
     uint32_t getComponents() const { return m_frameDescr.components; }
 
+    MovementAnalyzer::Metrics getMovementMetrics() const { return m_moveAnalyzer.getMetrics(); }
+    const MotionHeatmap& getMotionHeatmap() const { return m_moveAnalyzer.getHeatmap(); }
+    std::shared_ptr<DetectorPool> getDetectorPool() const { return m_detectorPool; }
+
     void subscribeOnCurrentFrame(OnCurrentFrameReady notifyFunc, void* ctx = nullptr, bool notifyOnce = true);
     void unsubscribeOnCurrentFrame(OnCurrentFrameReady notifyFunc, void* ctx = nullptr); // only for notifyOnce = false
 
@@ -71,41 +77,39 @@ private:
         StartedNewVideo,
     };
 
-    struct DetectionData {
-        std::mutex detectionMutex;
-        uint64_t frame;
-        uint32_t frameInBuffer;
-        bool jobIsReady = false;
-        std::shared_ptr<Detector> detector;
-    };
-
     bool isFrameChanged(const FrameU8& f1, const FrameU8& f2) const;
-    void runDetection(const FrameU8& frame);
-    void detect();
-    void detectionThreadFunc();
-    RecordingResult recording(const std::string& filename, uint64_t frameNr, uint32_t frameInBuffer);
+    void runDetection(uint64_t frameNr, std::vector<DetectionBox> regions);
+    std::vector<FrameU8> burstFrames(const FrameU8& frame) const;
+    uint64_t publishedNr(uint32_t bufferIdx) const { return m_slotNr[bufferIdx].load(std::memory_order_acquire); }
+    bool copyFrame(uint64_t frameNr, FrameU8& out) const;
+    // called by detector pool worker, start - time of job submission
+    void detect(Detector& detector, DetectionStats& stats, uint64_t frameNr, uint32_t frameInBuffer, const std::chrono::steady_clock::time_point& start);
+    RecordingResult recording(const std::string& filename, uint64_t frameNr, uint32_t frameInBuffer, const FrameU8& detectedFrame);
     void feedRecorder(const FrameU8& frame);
     void notifyAboutDetection(const std::string& detectionInfo, const FrameU8 &f, const FrameDescr &fd);
     void notifyAboutVideoReady(const std::string& videoFilePath);
     void notifyAboutNewFrame();
 
-    static void onMovementDetected(uint64_t frameNumber, uint32_t bufferIdx, void* ctx);
+    static void onMovementDetected(uint64_t frameNumber, uint32_t bufferIdx, const std::vector<DetectionBox>& regions, void* ctx);
 
     double m_cameraFps = 0.0;
     double m_frameTime = 0.0;
 
     std::vector<FrameU8> m_cyclicBuffer;
 
-    uint64_t m_frameCtr = 0;
+    // written by camera thread only, other threads read slot after its number is published
+    std::atomic<uint64_t> m_frameCtr{0};          // the newest complete frame
+    std::vector<std::atomic<uint64_t>> m_slotNr;  // frame number held by slot of m_cyclicBuffer, 0 while it is written
     FrameDescr m_frameDescr; // common data for every frame
 
-    DetectionData m_detectionData;
-    volatile bool m_detectorThreadIsRunning = true;
-    std::mutex m_waitForDetectionTaskMtx;
-    std::condition_variable m_waitForDetectionTask;
-    std::thread m_detectorThread;
+    uint32_t m_burstFrames = 1;  // frames of event detected together, 1 - only triggering one
+    double m_burstPreRoll = 0.5; // [s] before triggering frame, burst frames are spread up to the newest one
+
+    std::mutex m_detectorPoolMutex;
+    std::shared_ptr<DetectorPool> m_detectorPool;
 
     MovementAnalyzer m_moveAnalyzer;
+    ObjectTracker m_tracker;
 
     std::mutex m_recorderMutex;
     std::chrono::steady_clock::time_point m_stopRecordingTime;
@@ -15,76 +15,160 @@
 //
 
 #include "ImgUtils.h"
-#include <math.h>
+#include "ThreadPool.h"
+#include "CppTools.h"
+#include <cmath>
 #include <assert.h>
 #include <type_traits>
-#include <type_traits>
-
-//#include <iostream>
-//#include <iomanip>
+#include <limits>
+#include <algorithm>
+#include <mutex>
 
 namespace ImgUtils
 {
 
-template<typename InData, typename OutData>
-OutData avarageColor(uint32_t x, uint32_t y, uint32_t c,
-                     const InData* data, uint32_t width, uint32_t height, uint32_t components,
-                     uint32_t componentMove, uint32_t pixelMove,
-                     double wAspect, double hAspect)
+namespace {
+
+constexpr size_t COEFFICIENTS_CACHE_SIZE = 32;
+
+std::shared_ptr<const AxisCoefficients> makeCoefficients(uint32_t inSize, uint32_t outSize, Filter filter)
 {
-    assert(c <= components);
-
-    uint32_t rawX = static_cast<uint32_t>(wAspect * x);
-    uint32_t rawY = static_cast<uint32_t>(hAspect * y);
-
-
-    // choose type:
-    // - InData is float => float
-    // - InData is double => double
-    // - InData is int8 or int16 or int32 => int32  if bigger then take int64
-    // - InData is uint8 or uint16 or uint32 => uint32  if bigger then take uint64
-    using ACC_TYPE = typename std::conditional<std::is_floating_point<InData>::value,
-                                               typename std::conditional<(sizeof(InData) > sizeof(float)), double, float>::type,
-                                               typename std::conditional<std::is_unsigned<InData>::value,
-                                                                         typename std::conditional<(sizeof(InData) > sizeof(uint32_t)), uint64_t, uint32_t>::type,
-                                                                         typename std::conditional<(sizeof(InData) > sizeof(int32_t)),   int64_t,  int32_t>::type
-                                                                        >::type
-                                              >::type;
-    ACC_TYPE accColor = 0;
-
-    uint32_t maskX = static_cast<uint32_t>(wAspect + 0.5);
-    uint32_t maskY = static_cast<uint32_t>(hAspect + 0.5);
-    uint32_t rawXEnd = std::min(rawX+maskX, width);
-    uint32_t rawYEnd = std::min(rawY+maskY, height);
-    uint32_t maskSize = (rawXEnd - rawX) * (rawYEnd - rawY);
-
-    for (uint32_t imgY = rawY; imgY < rawYEnd; ++imgY) {
-        for (uint32_t imgX = rawX; imgX < rawXEnd; ++imgX) {
-            accColor += static_cast<ACC_TYPE>(
-                            data[(imgY*width+imgX)*pixelMove + c*componentMove]
-                        );
+    assert(inSize > 0 && outSize > 0);
+
+    auto coeffs = std::make_shared<AxisCoefficients>();
+    coeffs->inSize = inSize;
+    coeffs->outSize = outSize;
+    coeffs->filter = filter;
+
+    // output pixel i covers input range [i*scale, (i+1)*scale)
+    const double scale = static_cast<double>(inSize) / outSize;
+    const uint32_t maxTaps = filter == Area ? static_cast<uint32_t>(std::ceil(scale)) + 1 : 2;
+    coeffs->taps = std::min(maxTaps, inSize);
+    coeffs->begin.resize(outSize);
+    coeffs->weights.assign(static_cast<size_t>(outSize) * coeffs->taps, 0.0f);
+
+    for (uint32_t i = 0; i < outSize; ++i) {
+        float* w = &coeffs->weights[static_cast<size_t>(i) * coeffs->taps];
+        if (filter == Area) {
+            const double from = i * scale;
+            const double to = std::min((i + 1) * scale, static_cast<double>(inSize));
+            const uint32_t first = static_cast<uint32_t>(from);
+            const uint32_t begin = std::min(first, inSize - coeffs->taps);
+            coeffs->begin[i] = begin;
+            for (uint32_t j = first; j < inSize && j < to; ++j) {
+                // covered part of input pixel j - fractional at both ends for non-integer ratios
+                const double coverage = std::min(to, j + 1.0) - std::max(from, static_cast<double>(j));
+                w[j - begin] = static_cast<float>(coverage / (to - from));
+            }
+        }
+        else {
+            // pixel centers are aligned, edges are clamped
+            const double center = std::min(std::max((i + 0.5) * scale - 0.5, 0.0), inSize - 1.0);
+            const uint32_t first = static_cast<uint32_t>(center);
+            const float fraction = static_cast<float>(center - first);
+            const uint32_t begin = std::min(first, inSize - coeffs->taps);
+            coeffs->begin[i] = begin;
+            w[first - begin] += 1.0f - fraction;
+            if (fraction > 0.0f) {
+                w[first + 1 - begin] += fraction;
+            }
         }
     }
+    return coeffs;
+}
 
-    // choose bigger or smaller floating point
-    using RESULT_TYPE = typename std::conditional<std::is_floating_point<InData>::value,
-                                                  typename std::conditional<(sizeof(InData) > sizeof(float)), double, float>::type,
-                                                  typename std::conditional<(sizeof(InData) > sizeof(int32_t)), double, float>::type
-                                                 >::type;
-    RESULT_TYPE maxComponentDivider = RESULT_TYPE(1.0);
-    if (!std::is_floating_point<InData>::value && std::is_floating_point<OutData>::value) {  // int -> float
-        maxComponentDivider = RESULT_TYPE(size_t(std::numeric_limits<InData>::max()));
+///
+/// \brief The Layout struct - offsets of columns and rows, index of (x, y, c) = rowOffset[y] + columnOffset[x] + c*componentMove.
+///                           Tile position is separable too, so tiled orders are addressed the same way.
+///
+struct Layout
+{
+    std::vector<size_t> rowOffset;
+    std::vector<size_t> columnOffset;
+    size_t componentMove = 0;
+
+    void reset(uint32_t w, uint32_t h, uint32_t c, DataOrder order, uint32_t tileSize)
+    {
+        const bool tiled = order == PixelTile || order == ComponentTile;
+        const bool pixelOrder = order == Pixel || order == PixelTile;
+        // not tiled image is one tile
+        const uint32_t tileW = tiled && tileSize > 0 ? tileSize : w;
+        const uint32_t tileH = tiled && tileSize > 0 ? tileSize : h;
+        const size_t tilesX = (w + tileW - 1) / tileW;
+        const size_t tileMove = static_cast<size_t>(tileW) * tileH * c;
+        const size_t pixelMove = pixelOrder ? c : 1;
+        componentMove = pixelOrder ? 1 : static_cast<size_t>(tileW) * tileH;
+
+        CppTools::fitBuffer(rowOffset, h);
+        for (uint32_t y = 0; y < h; ++y) {
+            rowOffset[y] = (y / tileH) * tilesX * tileMove + static_cast<size_t>(y % tileH) * tileW * pixelMove;
+        }
+        CppTools::fitBuffer(columnOffset, w);
+        for (uint32_t x = 0; x < w; ++x) {
+            columnOffset[x] = (x / tileW) * tileMove + (x % tileW) * pixelMove;
+        }
     }
-    else if(std::is_floating_point<InData>::value && !std::is_floating_point<OutData>::value) { // float -> int
-        //there could be a problem e.g. if user want to express Uint8 values as Uint32
-        maxComponentDivider = RESULT_TYPE(1) / RESULT_TYPE(size_t(std::numeric_limits<OutData>::max()));
+
+    size_t index(uint32_t x, uint32_t y, uint32_t c) const { return rowOffset[y] + columnOffset[x] + c*componentMove; }
+};
+
+///
+/// \brief The Scratch struct - buffers of resize kept between calls, one set per thread (and accumulator type).
+///                            They follow size of the last image - memory of much bigger one is released.
+///
+template<typename AccType>
+struct Scratch
+{
+    Layout in;
+    Layout out;
+    std::vector<AccType> rows; // horizontally resampled input rows - used by calling thread
+    std::vector<AccType> row;  // one output row in vertical pass - used by every strip thread
+};
+
+template<typename AccType>
+Scratch<AccType>& scratch()
+{
+    thread_local Scratch<AccType> s;
+    return s;
+}
+
+template<typename OutData, typename AccType>
+OutData toOutput(AccType value)
+{
+    if (std::is_floating_point<OutData>::value) {
+        return static_cast<OutData>(value);
+    }
+    value = std::floor(value + AccType(0.5));
+    if (value <= static_cast<AccType>(std::numeric_limits<OutData>::lowest())) {
+        return std::numeric_limits<OutData>::lowest();
+    }
+    if (value >= static_cast<AccType>(std::numeric_limits<OutData>::max())) {
+        return std::numeric_limits<OutData>::max();
+    }
+    return static_cast<OutData>(value);
+}
+
+} // namespace
+
+std::shared_ptr<const AxisCoefficients> axisCoefficients(uint32_t inSize, uint32_t outSize, Filter filter)
+{
+    static std::mutex mutex;
+    static std::vector<std::shared_ptr<const AxisCoefficients>> cache; // most recently used first
+
+    const std::lock_guard<std::mutex> lg(mutex);
+    auto it = std::find_if(cache.begin(), cache.end(), [=] (const std::shared_ptr<const AxisCoefficients>& c) {
+        return c->inSize == inSize && c->outSize == outSize && c->filter == filter;
+    });
+    if (it != cache.end()) {
+        std::rotate(cache.begin(), it, it + 1);
+        return cache.front();
     }
-    // Currently do nothing with integers signed/unsigned, scaling with the range etc.
 
-    OutData outVal = OutData(RESULT_TYPE(accColor) / maskSize / maxComponentDivider);
-    //std::cout << "outVal: " << std::fixed << std::setprecision(5) << outVal << " avg: " << RESULT_TYPE(accColor) / maskSize
-    //          << " div: " << maxComponentDivider << " max:" << std::numeric_limits<InData>::max() << "\n";
-    return outVal;
+    if (cache.size() >= COEFFICIENTS_CACHE_SIZE) {
+        cache.pop_back();
+    }
+    cache.insert(cache.begin(), makeCoefficients(inSize, outSize, filter));
+    return cache.front();
 }
 
 
@@ -92,7 +176,8 @@ template<typename InType, typename OutType>
 void resizeTmpl(uint32_t inW, uint32_t inH, uint32_t inC, const InType *inData, ImgUtils::DataOrder inOrder, uint32_t inTileSize,
                       uint32_t outW, uint32_t outH, uint32_t outC, OutType *outData, ImgUtils::DataOrder outOrder, uint32_t outTileSize,
                       bool keepProportion,
-                      const OutType* outClearValue, uint32_t* outNewX, uint32_t* outNewY, uint32_t* outNewW, uint32_t* outNewH)
+                      const OutType* outClearValue, uint32_t* outNewX, uint32_t* outNewY, uint32_t* outNewW, uint32_t* outNewH,
+                      uint32_t maxThreads, Filter filter)
 {
     uint32_t newX = 0;
     uint32_t newY = 0;
@@ -128,96 +213,122 @@ void resizeTmpl(uint32_t inW, uint32_t inH, uint32_t inC, const InType *inData,
 
 
     const uint32_t cMax = std::min(inC, outC);
+    const bool scaled = inW > 0 && inH > 0 && newW > 0 && newH > 0 && cMax > 0;
 
-    double wAspect = static_cast<double>(inW) / static_cast<double>(newW);
-    double hAspect = static_cast<double>(inH) / static_cast<double>(newH);
-
-    bool inIsTiled = inOrder == PixelTile || inOrder == ComponentTile;
-    bool outIsTiled = outOrder == PixelTile || outOrder == ComponentTile;
-
-
-    if (!inIsTiled && !outIsTiled) {
-        uint32_t inComponentMove = inOrder == Pixel ? 1 : inW*inH;
-        uint32_t inPixelMove = inOrder == Pixel ? inC : 1;
+    // accumulate in float, double for 64 bit input
+    using ACC_TYPE = typename std::conditional<(sizeof(InType) > sizeof(float)), double, float>::type;
 
-        uint32_t outComponentMove = outOrder == Pixel ? 1 : outW*outH;
-        uint32_t outPixelMove = outOrder == Pixel ? outC : 1;
-
-        using ColorFunc = decltype (avarageColor<InType, OutType>);
-        ColorFunc* colorFunc = nullptr;
+    ACC_TYPE outScale = ACC_TYPE(1.0);
+    if (!std::is_floating_point<InType>::value && std::is_floating_point<OutType>::value) {  // int -> float
+        outScale = ACC_TYPE(1) / ACC_TYPE(std::numeric_limits<InType>::max());
+    }
+    else if(std::is_floating_point<InType>::value && !std::is_floating_point<OutType>::value) { // float -> int
+        //there could be a problem e.g. if user want to express Uint8 values as Uint32
+        outScale = ACC_TYPE(std::numeric_limits<OutType>::max());
+    }
+    // Currently do nothing with integers signed/unsigned, scaling with the range etc.
 
-        if (wAspect >= 1.0) {
-            if (hAspect >= 1.0) {
-                colorFunc = avarageColor<InType, OutType>;
-            }
-            else {
-                assert(!"Not implemented yet!");
+    Scratch<ACC_TYPE>& buffers = scratch<ACC_TYPE>();
+    const Layout& in = buffers.in;
+    const Layout& out = buffers.out;
+    buffers.in.reset(inW, inH, inC, inOrder, inTileSize);
+    buffers.out.reset(outW, outH, outC, outOrder, outTileSize);
+
+    std::shared_ptr<const AxisCoefficients> xCoeffs;
+    std::shared_ptr<const AxisCoefficients> yCoeffs;
+    uint32_t firstRow = 0;
+    const size_t tmpRowSize = static_cast<size_t>(newW) * cMax;
+    if (scaled) {
+        xCoeffs = axisCoefficients(inW, newW, filter);
+        yCoeffs = axisCoefficients(inH, newH, filter);
+        const AxisCoefficients& cx = *xCoeffs;
+
+        // horizontal pass - only input rows read by vertical taps, interleaved newW x cMax values per row
+        firstRow = yCoeffs->begin.front();
+        const uint32_t rows = yCoeffs->begin.back() + yCoeffs->taps - firstRow;
+        CppTools::fitBuffer(buffers.rows, rows * tmpRowSize);
+        ACC_TYPE* tmp = buffers.rows.data();
+
+        ThreadPool::shared().parallelFor(rows, maxThreads, [&] (uint32_t rowBegin, uint32_t rowEnd, uint32_t) {
+            for (uint32_t r = rowBegin; r < rowEnd; ++r) {
+                const size_t inRow = in.rowOffset[firstRow + r];
+                ACC_TYPE* tmpRow = &tmp[r*tmpRowSize];
+                for (uint32_t x = 0; x < newW; ++x) {
+                    const float* w = &cx.weights[static_cast<size_t>(x)*cx.taps];
+                    const size_t* columns = &in.columnOffset[cx.begin[x]];
+                    for (uint32_t c = 0; c < cMax; ++c) {
+                        const InType* src = &inData[inRow + c*in.componentMove];
+                        ACC_TYPE acc = 0;
+                        for (uint32_t k = 0; k < cx.taps; ++k) {
+                            acc += ACC_TYPE(w[k]) * static_cast<ACC_TYPE>(src[columns[k]]);
+                        }
+                        tmpRow[x*cMax + c] = acc;
+                    }
+                }
             }
-        }
-        else {
-            assert(!"Not implemented yet!");
-        }
+        });
+    }
 
-        for (uint32_t component = 0; component < cMax; ++component) {
-            #pragma omp parallel for
-            for (uint32_t y = newY; y < newY + newH; ++y) {
-                for (uint32_t x = newX; x < newX + newW; ++x) {
-                    uint32_t idx = (y*outW + x)*outPixelMove + component*outComponentMove;
-                    outData[idx] = colorFunc(x-newX, y-newY, component,
-                                             inData, inW, inH, inC,
-                                             inComponentMove, inPixelMove,
-                                             wAspect, hAspect);
+    // vertical pass and padding around scaled image (and output components missing in input) - one pass over output rows
+    const ACC_TYPE* tmp = buffers.rows.data();
+    ThreadPool::shared().parallelFor(outH, maxThreads, [&] (uint32_t rowBegin, uint32_t rowEnd, uint32_t) {
+        auto clear = [&] (uint32_t xBegin, uint32_t xEnd, uint32_t y, uint32_t cBegin) {
+            for (uint32_t x = xBegin; x < xEnd; ++x) {
+                for (uint32_t c = cBegin; c < outC; ++c) {
+                    outData[out.index(x, y, c)] = outClearValue[c];
                 }
             }
-
-        }
-
-        if (newX > 0 || newY > 0) {
-            for (uint32_t component = 0; component < outC; ++component) {
-                //clear left right site
-                if (newX > 0) {
-                    #pragma omp parallel for
-                    for (uint32_t y = 0; y < newH; ++y) {
-                        uint32_t idx = y*outW*outPixelMove + component*outComponentMove;
-                        std::fill(&outData[idx], &outData[idx+newX*outPixelMove], outClearValue[component]); // fill left
-                        std::fill(&outData[idx + (newX + newW)*outPixelMove], &outData[idx+outW*outPixelMove], outClearValue[component]); // fill right
-                    }
+        };
+
+        std::vector<ACC_TYPE>& rowAcc = scratch<ACC_TYPE>().row;
+        CppTools::fitBuffer(rowAcc, tmpRowSize);
+        for (uint32_t y = rowBegin; y < rowEnd; ++y) {
+            if (!scaled || y < newY || y >= newY + newH) {
+                clear(0, outW, y, 0);
+                continue;
+            }
+            clear(0, newX, y, 0);
+            clear(newX + newW, outW, y, 0);
+            clear(newX, newX + newW, y, cMax);
+
+            // weighted sum of whole rows, contiguous and vectorized by compiler
+            const AxisCoefficients& cy = *yCoeffs;
+            const uint32_t scaledY = y - newY;
+            const float* w = &cy.weights[static_cast<size_t>(scaledY)*cy.taps];
+            const ACC_TYPE* src = &tmp[(cy.begin[scaledY] - firstRow)*tmpRowSize];
+            std::fill(rowAcc.begin(), rowAcc.end(), ACC_TYPE(0));
+            for (uint32_t k = 0; k < cy.taps; ++k) {
+                if (w[k] == 0.0f) {
+                    continue;
                 }
-                else if (newY > 0) {
-                    //clear up
-                    #pragma omp parallel for
-                    for (uint32_t y = 0; y < newY; ++y) {
-                        uint32_t idx = y*outW*outPixelMove + component*outComponentMove;
-                        std::fill(&outData[idx], &outData[idx+outW*outPixelMove], outClearValue[component]);
-                    }
+                const ACC_TYPE wk = ACC_TYPE(w[k]) * outScale;
+                const ACC_TYPE* srcRow = &src[k*tmpRowSize];
+                for (size_t i = 0; i < tmpRowSize; ++i) {
+                    rowAcc[i] += wk * srcRow[i];
+                }
+            }
 
-                    //clear bottom
-                    #pragma omp parallel for
-                    for (uint32_t y = newY + newH; y < outH; ++y) {
-                        uint32_t idx = y*outW*outPixelMove + component*outComponentMove;
-                        std::fill(&outData[idx], &outData[idx+outW*outPixelMove], outClearValue[component]);
-                    }
+            for (uint32_t x = 0; x < newW; ++x) {
+                for (uint32_t c = 0; c < cMax; ++c) {
+                    outData[out.index(newX + x, y, c)] = toOutput<OutType>(rowAcc[x*cMax + c]);
                 }
             }
         }
-    }
-    else {
-        assert(!"Not implemented yet!");
-    }
+    });
 }
 
 
-
 void resize(uint32_t inW, uint32_t inH, uint32_t inC, const void *inData, ImgUtils::DataType inType, ImgUtils::DataOrder inOrder, uint32_t inTileSize,
                       uint32_t outW, uint32_t outH, uint32_t outC, void *outData, ImgUtils::DataType outType, ImgUtils::DataOrder outOrder, uint32_t outTileSize,
                       bool keepProportion,
-                      const void* outClearValue, uint32_t* outNewX, uint32_t* outNewY, uint32_t* outNewW, uint32_t* outNewH)
+                      const void* outClearValue, uint32_t* outNewX, uint32_t* outNewY, uint32_t* outNewW, uint32_t* outNewH,
+                      uint32_t maxThreads, Filter filter)
 {
 #define runResizeTempl(inDataT, outDataT, clearValT) \
     resizeTmpl(inW, inH, inC, inDataT, inOrder, inTileSize, \
                outW, outH, outC, outDataT, outOrder, outTileSize,\
                keepProportion,\
-               clearValT, outNewX, outNewY, outNewW, outNewH);
+               clearValT, outNewX, outNewY, outNewW, outNewH, maxThreads, filter);
 
 #define takeCastAndRun(outType)\
     outType* outDataT = reinterpret_cast<outType*>(outData); \
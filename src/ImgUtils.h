@@ -17,6 +17,8 @@
 #pragma once
 
 #include <cstdint>
+#include <memory>
+#include <vector>
 
 namespace ImgUtils
 {
@@ -39,16 +41,47 @@ enum DataOrder
 {
     Pixel,         // e.g. [RGB, RGB, RGB]
     Component,     // e.g. [RRR, GGG, BBB]
-    PixelTile,
-    ComponentTile,
+    PixelTile,     // image split into tileSize x tileSize tiles stored row by row, every tile in Pixel order,
+                   // tiles on right/bottom edge keep full tile size
+    ComponentTile, // the same tiles, every tile in Component order
 };
 
+enum Filter
+{
+    Area,      // average of covered input pixels weighted by covered part - downscaling without aliasing (upscaling gives blocky result)
+    Bilinear,  // two nearest pixels in each direction - upscaling, e.g. small crops and thumbnails
+};
+
+///
+/// \brief The AxisCoefficients struct - separable filter taps of one axis. Output index i is weighted sum of
+///                                      `taps` input values starting at begin[i], taps shorter than the widest one
+///                                      have zero weights.
+///
+struct AxisCoefficients
+{
+    uint32_t inSize = 0;
+    uint32_t outSize = 0;
+    Filter filter = Area;
+
+    uint32_t taps = 0;
+    std::vector<uint32_t> begin; // first input index per output index, begin[i] + taps <= inSize
+    std::vector<float> weights;  // outSize*taps, weights of one output index sum to 1
+};
+
+///
+/// \brief axisCoefficients - coefficients are built once per (input size, output size, filter) and shared,
+///                           the same frame, crop and thumbnail sizes repeat
+///
+std::shared_ptr<const AxisCoefficients> axisCoefficients(uint32_t inSize, uint32_t outSize, Filter filter);
+
 // The reason I haven't done it template is because I want to have it as simple header.
 // Under the hood I back to normal types without DataType
 void resize(uint32_t inW, uint32_t inH, uint32_t inC, const void* inData, DataType inType, DataOrder inOrder, uint32_t inTileSize,
             uint32_t outW, uint32_t outH, uint32_t outC, void* outData, DataType outType, DataOrder outOrder, uint32_t outTileSize,
             bool keepProportion,
-            const void* outClearValue, uint32_t* outNewX, uint32_t* outNewY, uint32_t* outNewW, uint32_t* outNewH // function give new position of scaled data - important mainly when keepProportion == true
+            const void* outClearValue, uint32_t* outNewX, uint32_t* outNewY, uint32_t* outNewW, uint32_t* outNewH, // function give new position of scaled data - important mainly when keepProportion == true
+            uint32_t maxThreads = 0, // threads of shared ThreadPool used for resizing, 0 - all
+            Filter filter = Area     // separable filter, coefficients are computed once per (input size, output size) pair
             );
 
 }
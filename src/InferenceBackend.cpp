@@ -0,0 +1,38 @@
+//
+// The MIT License (MIT)
+//
+// Copyright 2020 Karolpg
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), 
+// to deal in the Software without restriction, including without limitation the rights to #use, copy, modify, merge, publish, distribute, sublicense, 
+// and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR #COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, 
+// WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+
+#include "InferenceBackend.h"
+#include "DarknetBackend.h"
+#include "SyntheticBackend.h"
+
+#include <iostream>
+
+std::unique_ptr<InferenceBackend> InferenceBackend::create(const Config& cfg, uint32_t maxBatch)
+{
+    const std::string backend = cfg.getValue("detectorBackend", "darknet"); // copy - default is temporary
+    if (backend == "synthetic") {
+        return std::make_unique<SyntheticBackend>(cfg);
+    }
+    if (backend != "darknet") {
+        std::cerr << "Unknown detector backend: " << backend << "\n";
+        return nullptr;
+    }
+    auto darknet = std::make_unique<DarknetBackend>(cfg, maxBatch);
+    if (!darknet->isValid()) {
+        return nullptr;
+    }
+    return darknet;
+}
@@ -0,0 +1,64 @@
+//
+// The MIT License (MIT)
+//
+// Copyright 2020 Karolpg
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), 
+// to deal in the Software without restriction, including without limitation the rights to #use, copy, modify, merge, publish, distribute, sublicense, 
+// and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR #COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, 
+// WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+
+#pragma once
+
+#include <vector>
+#include <memory>
+#include <cstdint>
+#include <cstddef>
+#include "Config.h"
+#include "BoxUtils.h"
+
+///
+/// \brief The InferenceBackend class - one instance of detection network. Detector and InferenceBatcher see networks
+///                                     only through this interface, backend is chosen by "detectorBackend" config value:
+///                                     darknet - real network, synthetic - scripted results after configured latency
+///                                     (for benchmarks of capture, movement, recording and notifications without weights).
+///
+class InferenceBackend
+{
+public:
+    struct Detections {
+        std::vector<DetectionBox> boxes;  // relative to network input
+        std::vector<float> probabilities; // classes() values per box, below threshold are zero
+    };
+
+    virtual ~InferenceBackend() = default;
+
+    ///
+    /// \param maxBatch - the biggest count of inputs given to predict()
+    /// \return nullptr if backend can't be created (e.g. missing weights)
+    ///
+    static std::unique_ptr<InferenceBackend> create(const Config& cfg, uint32_t maxBatch);
+
+    virtual uint32_t width() const = 0;
+    virtual uint32_t height() const = 0;
+    virtual uint32_t channels() const = 0;
+    virtual uint32_t classes() const = 0;
+    size_t inputSize() const { return static_cast<size_t>(width()) * height() * channels(); } // floats of one input
+
+    ///
+    /// \param inputs - count planar network inputs one after another
+    ///
+    virtual void predict(const float* inputs, uint32_t count) = 0;
+
+    ///
+    /// \brief detections - results of one input of the last predict()
+    /// \param nmsIou - boxes of the same class overlapping more are suppressed, 0 - no NMS
+    ///
+    virtual void detections(uint32_t batchIdx, float threshold, float nmsIou, Detections& out) = 0;
+};
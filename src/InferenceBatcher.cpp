@@ -0,0 +1,190 @@
+//
+// The MIT License (MIT)
+//
+// Copyright 2020 Karolpg
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), 
+// to deal in the Software without restriction, including without limitation the rights to #use, copy, modify, merge, publish, distribute, sublicense, 
+// and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR #COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, 
+// WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+
+#include "InferenceBatcher.h"
+
+#include <iostream>
+#include <algorithm>
+#include <chrono>
+#include <thread>
+#include <cstring>
+#include <assert.h>
+
+InferenceBatcher::InferenceBatcher(const Config& cfg)
+    : m_maxBatch(std::max(1u, cfg.getValue("detectorMaxBatch", 4u)))
+    , m_window(cfg.getValue("detectorBatchWindow", 0.02))
+{
+    const uint32_t networks = std::max(1u, cfg.getValue("detectorNetworks", 1u));
+
+    // darknet layers own their weights, so instances can't share them - at least load them in parallel
+    std::vector<std::unique_ptr<InferenceBackend>> backends(networks);
+    std::vector<std::thread> loaders;
+    for (uint32_t n = 0; n < networks; ++n) {
+        loaders.emplace_back([&backends, n, &cfg, this] () {
+            backends[n] = InferenceBackend::create(cfg, m_maxBatch);
+        });
+    }
+    for (std::thread& loader : loaders) {
+        loader.join();
+    }
+
+    for (std::unique_ptr<InferenceBackend>& backend : backends) {
+        if (!backend) {
+            continue;
+        }
+        m_inputSize = backend->inputSize();
+
+        Instance instance;
+        instance.backend = std::move(backend);
+        instance.batchInput.resize(m_inputSize * m_maxBatch, 0.0f);
+        m_instances.push_back(std::move(instance));
+    }
+}
+
+void InferenceBatcher::attachSource()
+{
+    const std::lock_guard<std::mutex> lg(m_mutex);
+    ++m_sources;
+}
+
+void InferenceBatcher::detachSource()
+{
+    {
+        const std::lock_guard<std::mutex> lg(m_mutex);
+        assert(m_sources > 0);
+        --m_sources;
+    }
+    m_cv.notify_all(); // leader may wait for this source
+}
+
+void InferenceBatcher::run(const Request& request)
+{
+    assert(isValid());
+    assert(request.count > 0 && request.count <= m_maxBatch);
+
+    Pending pending{&request};
+    std::unique_lock<std::mutex> ul(m_mutex);
+    m_pending.push_back(&pending);
+    m_cv.notify_all();
+
+    auto pendingInputs = [this] () {
+        uint32_t inputs = 0;
+        for (const Pending* p : m_pending) {
+            inputs += p->request->count;
+        }
+        return inputs;
+    };
+
+    while (!pending.done) {
+        if (pending.taken || m_activeLeaders >= m_instances.size()) {
+            m_cv.wait(ul, [this, &pending] { return pending.done || (!pending.taken && m_activeLeaders < m_instances.size()); });
+            continue;
+        }
+
+        ++m_activeLeaders;
+        Instance* instance = nullptr;
+        for (Instance& i : m_instances) {
+            if (!i.busy) {
+                instance = &i;
+                break;
+            }
+        }
+        assert(instance);
+        instance->busy = true;
+
+        if (m_window > 0.0) {
+            auto deadline = std::chrono::steady_clock::now() + std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(m_window));
+            m_cv.wait_until(ul, deadline, [this, &pendingInputs] {
+                return pendingInputs() >= m_maxBatch || m_pending.size() + m_inFlight >= m_sources;
+            });
+        }
+
+        // FIFO, request which doesn't fit waits for next batch
+        std::vector<Pending*> batch;
+        uint32_t inputs = 0;
+        for (auto it = m_pending.begin(); it != m_pending.end();) {
+            if (inputs + (*it)->request->count <= m_maxBatch) {
+                inputs += (*it)->request->count;
+                (*it)->taken = true;
+                batch.push_back(*it);
+                it = m_pending.erase(it);
+            }
+            else {
+                ++it;
+            }
+        }
+        if (batch.empty()) {
+            // other leader took everything while this one waited
+            instance->busy = false;
+            --m_activeLeaders;
+            m_cv.notify_all();
+            continue;
+        }
+        m_inFlight += static_cast<uint32_t>(batch.size());
+
+        ul.unlock();
+        predict(*instance, batch, inputs);
+        ul.lock();
+
+        for (Pending* p : batch) {
+            p->done = true;
+        }
+        m_inFlight -= static_cast<uint32_t>(batch.size());
+        ++m_metrics.batches;
+        m_metrics.requests += batch.size();
+        m_metrics.inputs += inputs;
+        instance->busy = false;
+        --m_activeLeaders;
+        m_cv.notify_all();
+    }
+}
+
+void InferenceBatcher::warmUp()
+{
+    for (Instance& instance : m_instances) {
+        std::fill(instance.batchInput.begin(), instance.batchInput.end(), 0.5f);
+        instance.backend->predict(instance.batchInput.data(), m_maxBatch);
+    }
+}
+
+void InferenceBatcher::predict(Instance& instance, const std::vector<Pending*>& batch, uint32_t inputs)
+{
+    const float* netInput = batch.front()->request->inputs;
+    if (batch.size() > 1) {
+        // one contiguous batch tensor
+        size_t offset = 0;
+        for (const Pending* p : batch) {
+            std::memcpy(&instance.batchInput[offset], p->request->inputs, p->request->count * m_inputSize * sizeof(float));
+            offset += p->request->count * m_inputSize;
+        }
+        netInput = instance.batchInput.data();
+    }
+
+    instance.backend->predict(netInput, inputs);
+
+    uint32_t batchIdx = 0;
+    for (const Pending* p : batch) {
+        for (uint32_t i = 0; i < p->request->count; ++i) {
+            p->request->collect(*instance.backend, batchIdx++, i);
+        }
+    }
+}
+
+InferenceBatcher::Metrics InferenceBatcher::getMetrics() const
+{
+    const std::lock_guard<std::mutex> lg(m_mutex);
+    return m_metrics;
+}
@@ -0,0 +1,109 @@
+//
+// The MIT License (MIT)
+//
+// Copyright 2020 Karolpg
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), 
+// to deal in the Software without restriction, including without limitation the rights to #use, copy, modify, merge, publish, distribute, sublicense, 
+// and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR #COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, 
+// WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+
+#pragma once
+
+#include <vector>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <cstdint>
+#include <memory>
+#include "Config.h"
+#include "InferenceBackend.h"
+
+///
+/// \brief The InferenceBatcher class - owns networks and runs inputs of several sources (cameras, crops) in one network pass.
+///                                     Calling thread which finds free network becomes leader: it waits up to batch window
+///                                     for inputs of other sources, packs them into one batch and runs prediction.
+///                                     There is no own thread - every source waits in run() until its batch is done.
+///                                     With several network instances several batches run at once.
+///
+class InferenceBatcher
+{
+public:
+    ///
+    /// \brief CollectFunc - called by leader right after prediction, backend detections are valid only during the call
+    /// \param batchIdx - position of input in network batch
+    /// \param inputIdx - position of input in request
+    ///
+    using CollectFunc = std::function<void(InferenceBackend& backend, uint32_t batchIdx, uint32_t inputIdx)>;
+
+    struct Request {
+        const float* inputs = nullptr; // count network inputs one after another
+        uint32_t count = 0;            // <= maxBatch()
+        CollectFunc collect;
+    };
+
+    struct Metrics {
+        uint64_t batches = 0;
+        uint64_t requests = 0;
+        uint64_t inputs = 0;
+    };
+
+    InferenceBatcher(const Config& cfg);
+
+    bool isValid() const { return !m_instances.empty(); }
+    const InferenceBackend* backend() const { return m_instances.front().backend.get(); } // for dimensions - every instance is the same
+    uint32_t networks() const { return static_cast<uint32_t>(m_instances.size()); }
+    uint32_t maxBatch() const { return m_maxBatch; }
+    size_t inputSize() const { return m_inputSize; } // floats of one network input
+
+    // sources which prepare input are counted - window is not waited when every such source already gave its input
+    void attachSource();
+    void detachSource();
+
+    ///
+    /// \brief run - blocks until request is predicted and collected
+    ///
+    void run(const Request& request);
+
+    ///
+    /// \brief warmUp - one full batch on every instance, so the first real request doesn't pay for lazy allocations.
+    ///                 Only before batcher is used by sources.
+    ///
+    void warmUp();
+
+    Metrics getMetrics() const;
+
+private:
+    struct Pending {
+        const Request* request;
+        bool taken = false; // by leader
+        bool done = false;
+    };
+
+    struct Instance {
+        std::unique_ptr<InferenceBackend> backend;
+        bool busy = false;
+        std::vector<float> batchInput; // m_maxBatch network inputs one after another
+    };
+
+    void predict(Instance& instance, const std::vector<Pending*>& batch, uint32_t inputs);
+
+    uint32_t m_maxBatch;
+    double m_window; // [s]
+    size_t m_inputSize = 0;
+
+    mutable std::mutex m_mutex;
+    std::condition_variable m_cv;
+    std::vector<Instance> m_instances;
+    std::vector<Pending*> m_pending; // FIFO, not taken yet
+    uint32_t m_activeLeaders = 0;
+    uint32_t m_inFlight = 0; // taken requests
+    uint32_t m_sources = 0;
+    Metrics m_metrics;
+};
@@ -0,0 +1,85 @@
+//
+// The MIT License (MIT)
+//
+// Copyright 2020 Karolpg
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), 
+// to deal in the Software without restriction, including without limitation the rights to #use, copy, modify, merge, publish, distribute, sublicense, 
+// and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR #COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, 
+// WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+
+
+#include "LatencyHistogram.h"
+
+#include <algorithm>
+#include <cmath>
+
+uint32_t LatencyHistogram::bucketOf(uint64_t us)
+{
+    if (us < SUB_BUCKETS) {
+        return static_cast<uint32_t>(us);
+    }
+    // the highest SUB_BITS + 1 bits of value select bucket
+    const uint32_t msb = 63u - static_cast<uint32_t>(__builtin_clzll(us));
+    const uint32_t shift = std::min(msb - SUB_BITS, MAX_SHIFT);
+    const uint64_t sub = std::min<uint64_t>(us >> shift, 2 * SUB_BUCKETS - 1);
+    return (shift + 1) * SUB_BUCKETS + static_cast<uint32_t>(sub - SUB_BUCKETS);
+}
+
+uint64_t LatencyHistogram::bucketUpperBound(uint32_t bucket)
+{
+    if (bucket < SUB_BUCKETS) {
+        return bucket;
+    }
+    const uint32_t shift = bucket / SUB_BUCKETS - 1;
+    const uint64_t sub = bucket % SUB_BUCKETS + SUB_BUCKETS;
+    return ((sub + 1) << shift) - 1;
+}
+
+void LatencyHistogram::record(std::chrono::steady_clock::duration duration)
+{
+    const int64_t signedUs = std::chrono::duration_cast<std::chrono::microseconds>(duration).count();
+    const uint64_t us = static_cast<uint64_t>(std::max<int64_t>(signedUs, 0));
+
+    m_buckets[bucketOf(us)].fetch_add(1, std::memory_order_relaxed);
+    m_sum.fetch_add(us, std::memory_order_relaxed);
+    uint64_t max = m_max.load(std::memory_order_relaxed);
+    while (us > max && !m_max.compare_exchange_weak(max, us, std::memory_order_relaxed)) {
+    }
+}
+
+LatencyHistogram::Snapshot LatencyHistogram::snapshot() const
+{
+    Snapshot s;
+    s.m_buckets.resize(BUCKETS);
+    for (uint32_t b = 0; b < BUCKETS; ++b) {
+        s.m_buckets[b] = m_buckets[b].load(std::memory_order_relaxed);
+        s.count += s.m_buckets[b];
+    }
+    s.mean = s.count > 0 ? static_cast<double>(m_sum.load(std::memory_order_relaxed)) * 1e-6 / static_cast<double>(s.count) : 0.0;
+    s.max = static_cast<double>(m_max.load(std::memory_order_relaxed)) * 1e-6;
+    return s;
+}
+
+double LatencyHistogram::Snapshot::percentile(double p) const
+{
+    if (count == 0) {
+        return 0.0;
+    }
+    const uint64_t rank = std::max<uint64_t>(1, static_cast<uint64_t>(std::ceil(p * static_cast<double>(count))));
+    uint64_t seen = 0;
+    for (uint32_t b = 0; b < m_buckets.size(); ++b) {
+        seen += m_buckets[b];
+        if (seen >= rank) {
+            const double upperBound = static_cast<double>(bucketUpperBound(b)) * 1e-6;
+            return max > 0.0 ? std::min(upperBound, max) : upperBound;
+        }
+    }
+    return max;
+}
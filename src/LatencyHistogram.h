@@ -0,0 +1,68 @@
+//
+// The MIT License (MIT)
+//
+// Copyright 2020 Karolpg
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), 
+// to deal in the Software without restriction, including without limitation the rights to #use, copy, modify, merge, publish, distribute, sublicense, 
+// and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR #COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, 
+// WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <vector>
+
+///
+/// \brief The LatencyHistogram class - lock free histogram of durations with microsecond resolution.
+///                                     Buckets are log-linear (16 per power of two, as in HDR histogram),
+///                                     so relative error of percentiles is below 7% from 1[us] up to hours.
+///                                     Recording is a few relaxed atomic increments - safe from any thread.
+///
+class LatencyHistogram
+{
+public:
+    struct Snapshot {
+        uint64_t count = 0;
+        double mean = 0.0; // [s]
+        double max = 0.0;  // [s]
+
+        ///
+        /// \param p - fraction of samples, e.g. 0.99
+        /// \return upper bound of bucket holding the p-th sample [s]
+        ///
+        double percentile(double p) const;
+
+    private:
+        friend class LatencyHistogram;
+        std::vector<uint64_t> m_buckets;
+    };
+
+    void record(std::chrono::steady_clock::duration duration);
+
+    // counts recorded in the middle of snapshot can be spread between its fields
+    Snapshot snapshot() const;
+
+private:
+    static constexpr uint32_t SUB_BITS = 4;
+    static constexpr uint32_t SUB_BUCKETS = 1u << SUB_BITS;
+    static constexpr uint32_t MAX_SHIFT = 38; // ~ 76 hours
+    static constexpr uint32_t BUCKETS = (MAX_SHIFT + 2) * SUB_BUCKETS;
+
+    static uint32_t bucketOf(uint64_t us);
+    static uint64_t bucketUpperBound(uint32_t bucket); // [us]
+
+    std::array<std::atomic<uint64_t>, BUCKETS> m_buckets{};
+    std::atomic<uint64_t> m_sum{0}; // [us]
+    std::atomic<uint64_t> m_max{0}; // [us]
+};
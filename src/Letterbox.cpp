@@ -0,0 +1,235 @@
+//
+// The MIT License (MIT)
+//
+// Copyright 2020 Karolpg
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), 
+// to deal in the Software without restriction, including without limitation the rights to #use, copy, modify, merge, publish, distribute, sublicense, 
+// and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR #COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, 
+// WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+
+#include "Letterbox.h"
+#include "ThreadPool.h"
+#include "CppTools.h"
+
+#include <algorithm>
+#include <assert.h>
+
+bool Letterbox::Geometry::operator==(const Geometry& other) const
+{
+    return inW == other.inW && inH == other.inH && inC == other.inC
+        && outW == other.outW && outH == other.outH && outC == other.outC
+        && newX == other.newX && newY == other.newY && newW == other.newW && newH == other.newH;
+}
+
+Letterbox::Letterbox(const Geometry& geometry)
+    : m_geometry(geometry)
+{
+    const Geometry& g = m_geometry;
+    assert(g.inW && g.inH && g.newW && g.newH);
+    assert(g.newX + g.newW <= g.outW && g.newY + g.newH <= g.outH);
+
+    // integer downscale on both axes (e.g. crop of network size) - area weights are equal boxes without overlap,
+    // plain integer sums give exactly the same result for a fraction of the cost
+    if (g.inW % g.newW == 0 && g.inH % g.newH == 0 && (g.inC == 1 || g.inC == 3 || g.inC == 4)) {
+        m_boxW = g.inW / g.newW;
+        m_boxH = g.inH / g.newH;
+        m_usedValues = g.inW * g.inC;
+        m_outScale = 1.0f / (255.0f * m_boxW * m_boxH);
+        return;
+    }
+
+    // small crops can be enlarged - area average would make blocks of them
+    auto filter = [] (uint32_t inSize, uint32_t outSize) {
+        return outSize > inSize ? ImgUtils::Bilinear : ImgUtils::Area;
+    };
+
+    m_xCoeffs = ImgUtils::axisCoefficients(g.inW, g.newW, filter(g.inW, g.newW));
+    m_yCoeffs = ImgUtils::axisCoefficients(g.inH, g.newH, filter(g.inH, g.newH));
+    m_usedValues = (m_xCoeffs->begin.back() + m_xCoeffs->taps) * g.inC; // columns behind the last taps are not needed
+
+    m_yWeights.resize(m_yCoeffs->weights.size());
+    for (size_t i = 0; i < m_yWeights.size(); ++i) {
+        m_yWeights[i] = static_cast<uint16_t>(m_yCoeffs->weights[i] * (1u << ROW_WEIGHT_BITS) + 0.5f);
+    }
+    m_outScale = 1.0f / (255.0f * (1u << ROW_WEIGHT_BITS));
+}
+
+void Letterbox::run(const uint8_t* in, size_t inStride, float* out, float clearValue, uint32_t maxThreads) const
+{
+    const Geometry& g = m_geometry;
+    const size_t plane = static_cast<size_t>(g.outW) * g.outH;
+
+    // padding - rows above and below scaled image, columns on its sides are filled by row pass
+    for (uint32_t c = 0; c < g.outC; ++c) {
+        float* outPlane = &out[c*plane];
+        std::fill(outPlane, outPlane + g.newY*g.outW, clearValue);
+        std::fill(outPlane + (g.newY + g.newH)*g.outW, outPlane + plane, clearValue);
+        if (c >= g.inC) {
+            std::fill(outPlane + g.newY*g.outW, outPlane + (g.newY + g.newH)*g.outW, clearValue);
+        }
+    }
+
+    ThreadPool::shared().parallelFor(g.newH, maxThreads, [this, in, inStride, out, clearValue] (uint32_t yBegin, uint32_t yEnd, uint32_t) {
+        const Geometry& g = m_geometry;
+        const size_t plane = static_cast<size_t>(g.outW) * g.outH;
+        const uint32_t cMax = std::min(g.inC, g.outC);
+        for (uint32_t c = 0; c < cMax; ++c) {
+            for (uint32_t y = yBegin; y < yEnd; ++y) {
+                float* outRow = &out[c*plane + (g.newY + y)*g.outW];
+                std::fill(outRow, outRow + g.newX, clearValue);
+                std::fill(outRow + g.newX + g.newW, outRow + g.outW, clearValue);
+            }
+        }
+
+        thread_local RowScratch row;
+        CppTools::fitBuffer(row.sum, m_usedValues);
+        if (m_boxW) {
+            switch (g.inC) {
+                case 1: runBoxRows<1>(in, inStride, out, yBegin, yEnd, row); break;
+                case 3: runBoxRows<3>(in, inStride, out, yBegin, yEnd, row); break;
+                case 4: runBoxRows<4>(in, inStride, out, yBegin, yEnd, row); break;
+                default: assert(!"Box path is chosen only for 1, 3 and 4 components!"); break;
+            }
+            return;
+        }
+
+        CppTools::fitBuffer(row.values, m_usedValues);
+        switch (g.inC) {
+            case 1: runRows<1>(in, inStride, out, yBegin, yEnd, row); break;
+            case 3: runRows<3>(in, inStride, out, yBegin, yEnd, row); break;
+            case 4: runRows<4>(in, inStride, out, yBegin, yEnd, row); break;
+            default: runRowsAnyC(in, inStride, out, yBegin, yEnd, row); break;
+        }
+    });
+}
+
+void Letterbox::sumRows(const uint8_t* in, size_t inStride, uint32_t y, RowScratch& row) const
+{
+    // vertical pass - contiguous uint8 * uint16 -> uint32 multiply-adds, vectorized by compiler
+    const ImgUtils::AxisCoefficients& cy = *m_yCoeffs;
+    const uint16_t* w = &m_yWeights[static_cast<size_t>(y) * cy.taps];
+    const uint32_t usedValues = m_usedValues; // local - sum writes could alias the member
+    uint32_t* sum = row.sum.data();
+    std::fill(sum, sum + usedValues, 0u);
+    for (uint32_t k = 0; k < cy.taps; ++k) {
+        if (w[k] == 0) {
+            continue;
+        }
+        const uint16_t wk = w[k]; // 16 bit - widening multiply
+        const uint8_t* inRow = &in[(cy.begin[y] + k)*inStride];
+        for (uint32_t i = 0; i < usedValues; ++i) {
+            sum[i] += wk * inRow[i];
+        }
+    }
+
+    // converted once - horizontal taps read every value several times
+    float* values = row.values.data();
+    for (uint32_t i = 0; i < usedValues; ++i) {
+        values[i] = static_cast<float>(sum[i]) * m_outScale;
+    }
+}
+
+template<uint32_t C>
+void Letterbox::runBoxRows(const uint8_t* in, size_t inStride, float* out, uint32_t yBegin, uint32_t yEnd, RowScratch& row) const
+{
+    const Geometry& g = m_geometry;
+    const size_t plane = static_cast<size_t>(g.outW) * g.outH;
+    const uint32_t cMax = std::min(C, g.outC);
+    const uint32_t usedValues = m_usedValues; // locals - sum writes could alias members
+    const uint32_t boxW = m_boxW;
+    const uint32_t boxH = m_boxH;
+    const float scale = m_outScale;
+    uint32_t* sum = row.sum.data();
+
+    for (uint32_t y = yBegin; y < yEnd; ++y) {
+        // vertical pass - contiguous uint8 -> uint32 adds, vectorized by compiler
+        const uint8_t* inRow = &in[static_cast<size_t>(y) * boxH * inStride];
+        for (uint32_t i = 0; i < usedValues; ++i) {
+            sum[i] = inRow[i];
+        }
+        for (uint32_t k = 1; k < boxH; ++k) {
+            inRow += inStride;
+            for (uint32_t i = 0; i < usedValues; ++i) {
+                sum[i] += inRow[i];
+            }
+        }
+
+        // horizontal pass - box sum, normalization and planarization
+        float* outRow = &out[(g.newY + y)*g.outW + g.newX];
+        for (uint32_t x = 0; x < g.newW; ++x) {
+            const uint32_t* src = &sum[x*boxW*C];
+            uint32_t acc[C] = {};
+            for (uint32_t k = 0; k < boxW; ++k) {
+                for (uint32_t c = 0; c < C; ++c) {
+                    acc[c] += src[k*C + c];
+                }
+            }
+            for (uint32_t c = 0; c < cMax; ++c) {
+                outRow[c*plane + x] = static_cast<float>(acc[c]) * scale;
+            }
+        }
+    }
+}
+
+template<uint32_t C>
+void Letterbox::runRows(const uint8_t* in, size_t inStride, float* out, uint32_t yBegin, uint32_t yEnd, RowScratch& row) const
+{
+    const Geometry& g = m_geometry;
+    const ImgUtils::AxisCoefficients& cx = *m_xCoeffs;
+    const size_t plane = static_cast<size_t>(g.outW) * g.outH;
+    const uint32_t cMax = std::min(C, g.outC);
+    const float* values = row.values.data();
+
+    for (uint32_t y = yBegin; y < yEnd; ++y) {
+        sumRows(in, inStride, y, row);
+
+        // horizontal pass - weighted sum of columns and planarization
+        float* outRow = &out[(g.newY + y)*g.outW + g.newX];
+        for (uint32_t x = 0; x < g.newW; ++x) {
+            const float* w = &cx.weights[static_cast<size_t>(x) * cx.taps];
+            const float* src = &values[cx.begin[x]*C];
+            float acc[C] = {};
+            for (uint32_t k = 0; k < cx.taps; ++k) {
+                for (uint32_t c = 0; c < C; ++c) {
+                    acc[c] += w[k] * src[k*C + c];
+                }
+            }
+            for (uint32_t c = 0; c < cMax; ++c) {
+                outRow[c*plane + x] = acc[c];
+            }
+        }
+    }
+}
+
+void Letterbox::runRowsAnyC(const uint8_t* in, size_t inStride, float* out, uint32_t yBegin, uint32_t yEnd, RowScratch& row) const
+{
+    const Geometry& g = m_geometry;
+    const ImgUtils::AxisCoefficients& cx = *m_xCoeffs;
+    const size_t plane = static_cast<size_t>(g.outW) * g.outH;
+    const uint32_t cMax = std::min(g.inC, g.outC);
+    const float* values = row.values.data();
+
+    for (uint32_t y = yBegin; y < yEnd; ++y) {
+        sumRows(in, inStride, y, row);
+
+        float* outRow = &out[(g.newY + y)*g.outW + g.newX];
+        for (uint32_t x = 0; x < g.newW; ++x) {
+            const float* w = &cx.weights[static_cast<size_t>(x) * cx.taps];
+            const float* src = &values[cx.begin[x]*g.inC];
+            for (uint32_t c = 0; c < cMax; ++c) {
+                float acc = 0.0f;
+                for (uint32_t k = 0; k < cx.taps; ++k) {
+                    acc += w[k] * src[k*g.inC + c];
+                }
+                outRow[c*plane + x] = acc;
+            }
+        }
+    }
+}
@@ -0,0 +1,78 @@
+//
+// The MIT License (MIT)
+//
+// Copyright 2020 Karolpg
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), 
+// to deal in the Software without restriction, including without limitation the rights to #use, copy, modify, merge, publish, distribute, sublicense, 
+// and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR #COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, 
+// WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+
+#pragma once
+
+#include <vector>
+#include <memory>
+#include <cstdint>
+#include <cstddef>
+#include "ImgUtils.h"
+
+///
+/// \brief The Letterbox class - network input preprocessing in one pass: resampling of uint8 interleaved image,
+///                              normalization to [0, 1], planar (CHW) float output and padding with clear value.
+///                              Filter taps are ImgUtils::AxisCoefficients shared per size pair - area average
+///                              when the axis is downscaled, bilinear when it is upscaled. Integer downscale
+///                              of both axes takes plain box sums instead of weighted taps.
+///
+class Letterbox
+{
+public:
+    struct Geometry {
+        uint32_t inW = 0, inH = 0, inC = 0;    // input image (e.g. crop)
+        uint32_t outW = 0, outH = 0, outC = 0; // network input
+        uint32_t newX = 0, newY = 0, newW = 0, newH = 0; // placement of scaled image in output
+
+        bool operator==(const Geometry& other) const;
+    };
+
+    explicit Letterbox(const Geometry& geometry);
+
+    const Geometry& geometry() const { return m_geometry; }
+
+    ///
+    /// \param in - first pixel of input image
+    /// \param inStride - bytes between input rows, image can be crop of bigger frame
+    /// \param out - outC planes of outW x outH floats, output channels missing in input are filled with clearValue
+    /// \param maxThreads - threads of shared ThreadPool, 0 - all
+    ///
+    void run(const uint8_t* in, size_t inStride, float* out, float clearValue, uint32_t maxThreads = 0) const;
+
+private:
+    // one input row after vertical pass, kept between runs by every thread
+    struct RowScratch {
+        std::vector<uint32_t> sum;
+        std::vector<float> values;
+    };
+
+    template<uint32_t C>
+    void runBoxRows(const uint8_t* in, size_t inStride, float* out, uint32_t yBegin, uint32_t yEnd, RowScratch& row) const;
+    template<uint32_t C>
+    void runRows(const uint8_t* in, size_t inStride, float* out, uint32_t yBegin, uint32_t yEnd, RowScratch& row) const;
+    void runRowsAnyC(const uint8_t* in, size_t inStride, float* out, uint32_t yBegin, uint32_t yEnd, RowScratch& row) const;
+    void sumRows(const uint8_t* in, size_t inStride, uint32_t y, RowScratch& row) const;
+
+    static constexpr uint32_t ROW_WEIGHT_BITS = 14; // fixed point row weights - vertical pass stays in integers
+
+    Geometry m_geometry;
+    std::shared_ptr<const ImgUtils::AxisCoefficients> m_xCoeffs; // input columns of output column of scaled image
+    std::shared_ptr<const ImgUtils::AxisCoefficients> m_yCoeffs;
+    std::vector<uint16_t> m_yWeights; // m_yCoeffs weights in fixed point
+    float m_outScale = 0.0f;          // fixed point row sum (box sum in box path) -> [0, 1]
+    uint32_t m_boxW = 0, m_boxH = 0;  // input pixels per output pixel of box path, 0 - weighted taps
+    uint32_t m_usedValues = 0; // values of input row read by horizontal taps
+};
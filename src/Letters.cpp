@@ -17,7 +17,6 @@
 #include "Letters.h"
 
 #include <unordered_map>
-#include <functional>
 
 namespace  {
 
@@ -1075,83 +1074,3 @@ const Letter& getLetterData(char c)
         return it->second;
     return ::EmptyLetter;
 }
-
-void drawString(std::vector<uint8_t>& data, uint32_t w, uint32_t h, uint32_t c,
-                uint32_t left, uint32_t up,
-                const std::string& text, float letterScale, uint32_t letterColorRgba, bool adjustScale)
-{
-    if (letterScale < 0.f) {
-        letterScale = 1.f;
-    }
-    if (left > w || up > h) {
-        return;
-    }
-
-    if (adjustScale) {
-        uint32_t restW = w - left;
-        uint32_t restH = h - up;
-        for (char l : text) {
-            const Letter& letter = getLetterData(l);
-            uint32_t lH = static_cast<uint32_t>(letter.h * letterScale);
-            if (lH > restH) {
-                letterScale = restH / letter.h;
-            }
-        }
-
-        uint32_t textW = 0;
-        uint32_t tries = 10;
-        float downScale = 0.9f;
-        bool textOk = false;
-        while (!textOk && --tries) {
-            for (char l : text) {
-                const Letter& letter = getLetterData(l);
-                uint32_t lW = static_cast<uint32_t>(letter.w * letterScale);
-                textW += lW;
-                if (textW > restW) {
-                    letterScale *= downScale;
-                    textOk = false;
-                    break;
-                }
-                textOk = true;
-            }
-        }
-    }
-
-    uint32_t letterLeft = left;
-    uint32_t letterUp = up;
-    for (char l : text) {
-        const Letter& letter = getLetterData(l);
-        uint32_t lH = static_cast<uint32_t>(letter.h * letterScale);
-        uint32_t lW = static_cast<uint32_t>(letter.w * letterScale);
-        uint32_t letterRight = letterLeft + lW - 1;
-        uint32_t letterBottom = letterUp + lH - 1;
-        bool stop = false;
-        if (letterRight > w - 1) {
-            letterRight = w - 1;
-            stop = true;
-        }
-        if (letterBottom > h - 1)
-            letterBottom = h - 1;
-        lH = letterBottom - letterUp + 1;
-        lW = letterRight - letterLeft + 1;
-
-        for (uint32_t y = 0; y < lH; ++y) {
-            for (uint32_t x = 0; x < lW; ++x) {
-                uint32_t letterPixelY = static_cast<uint32_t>(y / letterScale);
-                uint32_t letterPixelX = static_cast<uint32_t>(x / letterScale);
-                uint32_t letterPixelIdx = letterPixelY * letter.w + letterPixelX;
-                bool drawPixel = letter.data[letterPixelIdx] > 0;
-                if (drawPixel) {
-                    for (uint32_t k = 0; k < c; ++k) {
-                        data[(letterUp+y)*w*c + (letterLeft+x)*c + k] = static_cast<uint8_t>(letterColorRgba >> 8*k);
-                    }
-                }
-            }
-        }
-
-        letterLeft = letterRight;
-        if (stop)
-            break;
-    }
-
-}
@@ -0,0 +1,158 @@
+//
+// The MIT License (MIT)
+//
+// Copyright 2020 Karolpg
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), 
+// to deal in the Software without restriction, including without limitation the rights to #use, copy, modify, merge, publish, distribute, sublicense, 
+// and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR #COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, 
+// WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+
+#include "MotionHeatmap.h"
+#include "ColorGenerator.h"
+
+#include <algorithm>
+#include <cmath>
+
+MotionHeatmap::MotionHeatmap(const Config& cfg)
+    : m_enabled(cfg.getValue("motionHeatmap", 1) != 0)
+    , m_halfLife(std::max(0.0, cfg.getValue("motionHeatmapHalfLife", 21600.0)))
+    , m_epoch(Clock::now())
+{
+}
+
+void MotionHeatmap::resize(uint32_t width, uint32_t height)
+{
+    if (!m_enabled) {
+        return;
+    }
+    const uint32_t cellSize = 1u << CELL_SHIFT;
+    const std::lock_guard<std::mutex> lg(m_heatMutex);
+    m_width = (width + cellSize - 1) >> CELL_SHIFT;
+    m_height = (height + cellSize - 1) >> CELL_SHIFT;
+    m_hits.assign(m_width*m_height, 0);
+    m_heat.assign(m_width*m_height, 0);
+    m_weight = WEIGHT_ONE;
+    m_epoch = Clock::now();
+}
+
+void MotionHeatmap::updateWeight(const Clock::time_point& now)
+{
+    if (m_halfLife <= 0.0) {
+        return;
+    }
+    double halves = std::chrono::duration<double>(now - m_epoch).count() / m_halfLife;
+    if (halves >= RESCALE_SHIFT) {
+        // move epoch forward - heat is divided by the same factor, relations between cells stay the same
+        uint32_t shift = static_cast<uint32_t>(halves / RESCALE_SHIFT) * RESCALE_SHIFT;
+        for (uint64_t& heat : m_heat) {
+            heat = shift < 64 ? heat >> shift : 0;
+        }
+        m_epoch += std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(shift * m_halfLife));
+        halves -= shift;
+    }
+    m_weight = static_cast<uint64_t>(std::llround(WEIGHT_ONE * std::exp2(std::max(0.0, halves))));
+}
+
+void MotionHeatmap::commit(bool count, const std::vector<uint32_t>& tileActivity, uint32_t tilesX, uint32_t tileSize, const Clock::time_point& now)
+{
+    if (!m_enabled || m_hits.empty()) {
+        return;
+    }
+    const uint32_t cellsPerTile = tileSize >> CELL_SHIFT;
+    const uint32_t tilesY = static_cast<uint32_t>(tileActivity.size()) / tilesX;
+
+    const std::lock_guard<std::mutex> lg(m_heatMutex);
+    if (count) {
+        updateWeight(now);
+    }
+    for (uint32_t ty = 0; ty < tilesY; ++ty) {
+        for (uint32_t tx = 0; tx < tilesX; ++tx) {
+            if (!tileActivity[ty*tilesX + tx]) {
+                continue; // no hits in tile
+            }
+            const uint32_t cyEnd = std::min((ty + 1)*cellsPerTile, m_height);
+            const uint32_t cxEnd = std::min((tx + 1)*cellsPerTile, m_width);
+            for (uint32_t cy = ty*cellsPerTile; cy < cyEnd; ++cy) {
+                uint8_t* hits = &m_hits[cy*m_width];
+                uint64_t* heat = &m_heat[cy*m_width];
+                for (uint32_t cx = tx*cellsPerTile; cx < cxEnd; ++cx) {
+                    if (count) {
+                        heat[cx] += hits[cx] * m_weight;
+                    }
+                    hits[cx] = 0;
+                }
+            }
+        }
+    }
+}
+
+MotionHeatmap::Snapshot MotionHeatmap::snapshot() const
+{
+    Snapshot snapshot;
+    std::vector<uint64_t> heat;
+    uint64_t weight;
+    {
+        const std::lock_guard<std::mutex> lg(m_heatMutex);
+        snapshot.width = m_width;
+        snapshot.height = m_height;
+        heat = m_heat;
+        weight = m_weight;
+    }
+
+    uint64_t maxHeat = heat.empty() ? 0 : *std::max_element(heat.begin(), heat.end());
+    snapshot.heat.resize(heat.size(), 0.0f);
+    if (maxHeat == 0) {
+        return snapshot;
+    }
+    const double cellPixels = 1u << (2*CELL_SHIFT);
+    snapshot.maxActivity = maxHeat / (static_cast<double>(weight) * cellPixels);
+    for (size_t i = 0; i < heat.size(); ++i) {
+        snapshot.heat[i] = static_cast<float>(static_cast<double>(heat[i]) / maxHeat);
+    }
+    return snapshot;
+}
+
+bool MotionHeatmap::renderOverlay(const FrameU8& frame, const FrameDescr& descr, std::vector<uint8_t>& rgb) const
+{
+    Snapshot heatmap = snapshot();
+    if (heatmap.maxActivity <= 0.0 || descr.components == 0 || frame.data.size() < descr.width*descr.height*descr.components) {
+        return false;
+    }
+
+    static const std::vector<uint32_t> palette = ColorGenerator::generateHeatColorsRGB(COLOR_LEVELS);
+
+    rgb.resize(descr.width*descr.height*3);
+    for (uint32_t y = 0; y < descr.height; ++y) {
+        const uint32_t cy = std::min(y * heatmap.height / descr.height, heatmap.height - 1);
+        const float* heatRow = &heatmap.heat[cy*heatmap.width];
+        for (uint32_t x = 0; x < descr.width; ++x) {
+            const uint8_t* src = &frame.data[(y*descr.width + x)*descr.components];
+            uint8_t* dst = &rgb[(y*descr.width + x)*3];
+            for (uint32_t c = 0; c < 3; ++c) {
+                dst[c] = src[descr.components >= 3 ? c : 0];
+            }
+
+            const uint32_t cx = std::min(x * heatmap.width / descr.width, heatmap.width - 1);
+            // square root - rarely used places are still visible next to the hottest one
+            const float heat = std::sqrt(heatRow[cx]);
+            if (heat < MIN_VISIBLE_HEAT) {
+                continue;
+            }
+            const uint32_t level = std::min(static_cast<uint32_t>(heat * COLOR_LEVELS), COLOR_LEVELS - 1);
+            const uint32_t color = palette[level]; // 0xAABBGGRR
+            const float alpha = 0.3f + 0.4f * heat;
+            for (uint32_t c = 0; c < 3; ++c) {
+                const float colorComponent = static_cast<float>((color >> (8*c)) & 0xff);
+                dst[c] = static_cast<uint8_t>(dst[c] + (colorComponent - dst[c]) * alpha + 0.5f);
+            }
+        }
+    }
+    return true;
+}
@@ -0,0 +1,95 @@
+//
+// The MIT License (MIT)
+//
+// Copyright 2020 Karolpg
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), 
+// to deal in the Software without restriction, including without limitation the rights to #use, copy, modify, merge, publish, distribute, sublicense, 
+// and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR #COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, 
+// WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+
+#pragma once
+
+#include <vector>
+#include <chrono>
+#include <mutex>
+#include <cstdint>
+#include "Config.h"
+#include "Frame.h"
+
+///
+/// \brief The MotionHeatmap class - long term, exponentially decaying activity of every cell of analysis frame.
+///                                  Diff pass counts changed pixels per cell (hits), commit adds them to heat
+///                                  with weight growing in time, so old activity decays without touching all cells.
+///
+class MotionHeatmap
+{
+public:
+    using Clock = std::chrono::steady_clock;
+
+    static constexpr uint32_t CELL_SHIFT = 2; // cell = 4x4 pixels of analysis frame
+
+    struct Snapshot {
+        uint32_t width = 0;      // [cells]
+        uint32_t height = 0;     // [cells]
+        std::vector<float> heat; // [0, 1] - relative to the hottest cell
+        double maxActivity = 0.0; // decayed count of samples with fully changed hottest cell
+    };
+
+    MotionHeatmap(const Config& cfg);
+
+    bool isEnabled() const { return m_enabled; }
+
+    ///
+    /// \brief resize - clears heatmap
+    /// \param width, height - of analysis frame
+    ///
+    void resize(uint32_t width, uint32_t height);
+
+    ///
+    /// \brief hitsRow - hit counters of cells covering row y of analysis frame, nullptr when heatmap is disabled
+    ///                  Different tile rows can be filled concurrently.
+    ///
+    uint8_t* hitsRow(uint32_t y) { return m_enabled ? &m_hits[(y >> CELL_SHIFT)*m_width] : nullptr; }
+
+    ///
+    /// \brief commit - adds hits to heat (when count is true) and clears them. Only tiles with activity are visited.
+    ///
+    void commit(bool count, const std::vector<uint32_t>& tileActivity, uint32_t tilesX, uint32_t tileSize, const Clock::time_point& now);
+
+    Snapshot snapshot() const;
+
+    ///
+    /// \brief renderOverlay - frame blended with colorized heatmap
+    /// \param frame - any size, 1, 3 or 4 components
+    /// \param rgb - out, 3 components and the same size as frame
+    /// \return false when there is no activity yet
+    ///
+    bool renderOverlay(const FrameU8& frame, const FrameDescr& descr, std::vector<uint8_t>& rgb) const;
+
+private:
+    void updateWeight(const Clock::time_point& now);
+
+    bool m_enabled;
+    double m_halfLife; // [s] 0 - no decay
+
+    uint32_t m_width = 0;  // [cells]
+    uint32_t m_height = 0; // [cells]
+    std::vector<uint8_t> m_hits; // changed pixels per cell in current sample, written by diff pass only
+
+    mutable std::mutex m_heatMutex;
+    std::vector<uint64_t> m_heat; // fixed point, sum of hits * weight
+    uint64_t m_weight = WEIGHT_ONE; // weight of hit at current time: WEIGHT_ONE * 2^((now - epoch) / halfLife)
+    Clock::time_point m_epoch;
+
+    static constexpr uint64_t WEIGHT_ONE = 256;
+    static constexpr uint32_t RESCALE_SHIFT = 16; // heat is divided by 2^RESCALE_SHIFT when weight exceeds WEIGHT_ONE << RESCALE_SHIFT
+    static constexpr uint32_t COLOR_LEVELS = 16;
+    static constexpr float MIN_VISIBLE_HEAT = 1.0f / COLOR_LEVELS;
+};
@@ -16,53 +16,69 @@
 
 #include "MovementAnalyzer.h"
 
-#include "ImgUtils.h"
 #include "CppTools.h"
+#include "ThreadPool.h"
 
-#include <set>
+#include <limits>
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <atomic>
+#include <assert.h>
 
 //#include <string>
 //#include <sstream>
-//#include <iostream>
 //#include "PngTools.h"
 
 
-MovementAnalyzer::MovementAnalyzer()
+MovementAnalyzer::MovementAnalyzer(const Config& cfg)
+    : m_maxThreads(cfg.getValue("motionAnalyzerThreads", 0u))
+    , m_minInterval(cfg.getValue("motionMinInterval", 0.1))
+    , m_maxInterval(cfg.getValue("motionMaxInterval", 1.0))
+    , m_cpuBudget(cfg.getValue("motionCpuBudget", 0.25))
+    , m_compensationEnabled(cfg.getValue("motionCompensation", 1) != 0)
+    , m_maxShift(cfg.getValue("motionMaxShift", 8))
+    , m_exposureChangeArea(cfg.getValue("motionExposureChangeArea", 0.5f))
+    , m_triggerFilter(cfg)
+    , m_heatmap(cfg)
+{
+    m_maxInterval = std::max(m_minInterval, m_maxInterval);
+    m_activityInterval = std::clamp(TIME_BETWEEN_FRAMES, m_minInterval, m_maxInterval);
+    m_interval = m_activityInterval;
+    m_metrics.interval = m_interval;
+}
+
+void MovementAnalyzer::startCalculationThread()
 {
     m_calculationThread = std::thread([this] () {
-        while (m_threadIsRunning) {
+        while (true) {
             {
                 std::unique_lock<std::mutex> ul(m_waitForCalculationTaskMtx);
-                m_waitForCalculationTaskCv.wait(ul, [this] { return m_newTask; });
-            }
-            if (!m_threadIsRunning) {
-                break;
+                m_waitForCalculationTaskCv.wait(ul, [this] { return m_newTask || !m_threadIsRunning; });
+                if (!m_threadIsRunning) {
+                    break;
+                }
             }
 
-            //auto beginTime = std::chrono::steady_clock::now();
+            auto beginTime = std::chrono::steady_clock::now();
 
-            analyzeMovement();
+            bool movementDetected = analyzeMovement(m_nextFrame->time);
 
-            /*
-            {
-                auto processingTime = std::chrono::steady_clock::now() - beginTime;
-                double seconds = std::chrono::duration_cast<std::chrono::seconds>(processingTime).count();
-                double micro = std::chrono::duration_cast<std::chrono::microseconds>(processingTime).count();
-                std::cout << "MovementAnalyzer::analyzeMovement time: " << seconds << "[s]" << micro << "[us]\n";
-                std::cout.flush();
-            }
-            */
+            std::chrono::duration<double> processingTime = std::chrono::steady_clock::now() - beginTime;
+            //std::cout << "MovementAnalyzer::analyzeMovement time: " << processingTime.count() << "[s]\n";
 
-            std::swap(m_baseFrame, m_nextFrame);
-            m_newTask = false;
+            swapBase();
+            updateSchedule(movementDetected, m_bandPassTime + processingTime.count(), beginTime);
         }
     });
 }
 
 MovementAnalyzer::~MovementAnalyzer()
 {
-    m_threadIsRunning = true;
-    m_newTask = true;
+    {
+        std::lock_guard<std::mutex> lg(m_waitForCalculationTaskMtx);
+        m_threadIsRunning = false;
+    }
     m_waitForCalculationTaskCv.notify_all();
     if (m_calculationThread.joinable()) {
         m_calculationThread.join();
@@ -72,37 +88,160 @@ MovementAnalyzer::~MovementAnalyzer()
 
 void MovementAnalyzer::feedAnalyzer(const FrameU8 &frame, const FrameDescr &descr)
 {
-    if (m_descrOrg.components != descr.components
-        || m_descrOrg.width != descr.width
-        || m_descrOrg.height != descr.height) {
+    bool analysisIsRunning;
+    double interval;
+    {
+        std::lock_guard<std::mutex> lg(m_waitForCalculationTaskMtx);
+        analysisIsRunning = m_newTask;
+        interval = m_interval;
+    }
+
+    if (analysisIsRunning && (m_descrOrg.components != descr.components
+                              || m_descrOrg.width != descr.width
+                              || m_descrOrg.height != descr.height)) {
+        // buffers are still used by analysis - reallocate them with one of next frames
+        return;
+    }
+    if (resetBaseFrame(frame, descr)) {
         m_firstFrameTime = std::chrono::steady_clock::now();
-        m_descrOrg = descr;
-        m_descrBase.width = PREFERED_SIZE;
-        m_descrBase.height = PREFERED_SIZE;
-        m_descrBase.components = descr.components;
-        allocateMem();
-        m_baseFrame = &m_cacheBase[0];
-        m_nextFrame = &m_cacheBase[1];
-        m_baseFrame->nr = frame.nr;
-        m_baseFrame->bufferIdx = frame.bufferIdx;
-        scaleFrame(frame, descr, m_baseFrame);
+        if (!m_calculationThread.joinable()) {
+            startCalculationThread();
+        }
         return;
     }
 
     auto frameTime = std::chrono::steady_clock::now();
     std::chrono::duration<double> timeBetweenFrames = frameTime - m_firstFrameTime;
     double seconds = timeBetweenFrames.count();
-    if (seconds < TIME_BETWEEN_FRAMES) {
+    if (seconds < interval) {
+        return;
+    }
+
+    if (analysisIsRunning) {
+        const std::lock_guard<std::mutex> lg(m_metricsMtx);
+        ++m_metrics.busySkippedFrames;
         return;
     }
 
-    if (!m_newTask) {
+    // analysis thread doesn't touch m_nextFrame and band results until m_newTask is set
+    m_nextFrame->nr = frame.nr;
+    m_nextFrame->bufferIdx = frame.bufferIdx;
+    m_nextFrame->time = frame.time;
+    streamFrame(frame);
+    {
+        std::lock_guard<std::mutex> lg(m_waitForCalculationTaskMtx);
         m_newTask = true;
+    }
+    m_waitForCalculationTaskCv.notify_one();
+    m_firstFrameTime = frameTime;
+}
+
+bool MovementAnalyzer::analyzeFrame(const FrameU8 &frame, const FrameDescr &descr, StageTimes *times)
+{
+    assert(!m_calculationThread.joinable() && "Synchronous analysis can't be mixed with analysis thread!");
+
+    bool movementDetected = false;
+    if (resetBaseFrame(frame, descr)) {
+        m_stageTimes = StageTimes();
+    }
+    else {
         m_nextFrame->nr = frame.nr;
         m_nextFrame->bufferIdx = frame.bufferIdx;
-        scaleFrame(frame, descr, m_nextFrame);
-        m_waitForCalculationTaskCv.notify_one();
-        m_firstFrameTime = frameTime;
+        m_nextFrame->time = frame.time;
+        streamFrame(frame);
+        movementDetected = analyzeMovement(frame.time);
+        swapBase();
+    }
+
+    if (times) {
+        *times = m_stageTimes;
+    }
+    return movementDetected;
+}
+
+bool MovementAnalyzer::resetBaseFrame(const FrameU8 &frame, const FrameDescr &descr)
+{
+    if (m_descrOrg.components == descr.components
+        && m_descrOrg.width == descr.width
+        && m_descrOrg.height == descr.height) {
+        return false;
+    }
+    m_descrOrg = descr;
+    m_descrBase.width = PREFERED_SIZE;
+    m_descrBase.height = PREFERED_SIZE;
+    m_descrBase.components = descr.components;
+    allocateMem();
+    m_baseFrame = &m_cacheBase[0];
+    m_nextFrame = &m_cacheBase[1];
+    m_baseFrame->nr = frame.nr;
+    m_baseFrame->bufferIdx = frame.bufferIdx;
+    m_baseFrame->time = frame.time;
+    scaleFrame(frame, m_baseFrame);
+    makeProfiles(frame, m_baseProfiles);
+    return true;
+}
+
+void MovementAnalyzer::swapBase()
+{
+    std::swap(m_baseFrame, m_nextFrame);
+    std::swap(m_baseProfiles, m_nextProfiles);
+}
+
+MovementAnalyzer::Metrics MovementAnalyzer::getMetrics() const
+{
+    const std::lock_guard<std::mutex> lg(m_metricsMtx);
+    return m_metrics;
+}
+
+void MovementAnalyzer::updateSchedule(bool movementDetected, double latency, const std::chrono::steady_clock::time_point& analysisBegin)
+{
+    if (movementDetected) {
+        m_idleSamples = 0;
+        m_activityInterval = m_minInterval;
+    }
+    else if (++m_idleSamples > IDLE_SAMPLES_BEFORE_BACKOFF) {
+        m_activityInterval = std::min(m_maxInterval, m_activityInterval * BACKOFF_FACTOR);
+    }
+
+    // CPU budget - analysis runs on several threads, so its cost is estimated as latency * used threads
+    uint32_t poolThreads = ThreadPool::shared().threadCount() + 1;
+    uint32_t usedThreads = m_maxThreads ? std::min(m_maxThreads, poolThreads) : poolThreads;
+
+    double interval;
+    {
+        const std::lock_guard<std::mutex> lg(m_metricsMtx);
+        Metrics& m = m_metrics;
+        if (m.analyzedFrames == 0) {
+            m.analysisLatency = latency;
+        }
+        else {
+            m.analysisLatency += (latency - m.analysisLatency) * METRICS_SMOOTHING;
+            std::chrono::duration<double> sincePrev = analysisBegin - m_lastAnalysisBegin;
+            if (sincePrev.count() > 0.0) {
+                double rate = 1.0 / sincePrev.count();
+                m.sampleRate = m.analyzedFrames == 1 ? rate : m.sampleRate + (rate - m.sampleRate) * METRICS_SMOOTHING;
+            }
+        }
+        m.lastAnalysisLatency = latency;
+        ++m.analyzedFrames;
+        m.motionOngoing = movementDetected;
+        m.exposureChanges += m_exposureChange;
+        m.triggers = m_triggerFilter.counters();
+        m.gain = m_compensation.gain;
+        m.offset = m_compensation.offset;
+        m.shiftX = m_compensation.shiftX;
+        m.shiftY = m_compensation.shiftY;
+
+        double budgetInterval = m_cpuBudget > 0.0 ? m.analysisLatency * usedThreads / m_cpuBudget : 0.0;
+        interval = std::max(m_activityInterval, budgetInterval);
+        m.interval = interval;
+    }
+    m_lastAnalysisBegin = analysisBegin;
+
+    {
+        std::lock_guard<std::mutex> lg(m_waitForCalculationTaskMtx);
+        m_interval = interval;
+        m_newTask = false;
     }
 }
 
@@ -127,32 +266,342 @@ void MovementAnalyzer::unsubscribeOnMovementDetected(MovementAnalyzer::OnMovemen
 
 void MovementAnalyzer::allocateMem()
 {
-    for (uint32_t f = 0; f < m_cache.size(); ++f) {
-        m_cache[f].data.resize(m_descrBase.width*m_descrBase.height);
-    }
-
     for (uint32_t f = 0; f < m_cacheBase.size(); ++f) {
         m_cacheBase[f].data.resize(m_descrBase.width*m_descrBase.height*m_descrBase.components);
     }
+
+    m_tilesX = (m_descrBase.width + TILE_SIZE - 1) / TILE_SIZE;
+    m_tilesY = (m_descrBase.height + TILE_SIZE - 1) / TILE_SIZE;
+    m_tileActivity.resize(m_tilesX*m_tilesY);
+    m_heatmap.resize(m_descrBase.width, m_descrBase.height);
+    m_labelBlocks.resize(m_tilesY);
+    for (LabelBlock& block : m_labelBlocks) {
+        block.firstRow.resize(m_descrBase.width);
+        block.lastRow.resize(m_descrBase.width);
+    }
+
+    m_bandScratch.resize(ThreadPool::shared().threadCount() + 1);
+    for (BandScratch& scratch : m_bandScratch) {
+        scratch.rowSum.resize(m_descrBase.width*m_descrBase.components);
+        scratch.labels.resize(TILE_SIZE*m_descrBase.width);
+    }
+
+    // shared with other users of the same frame size
+    m_scaleX = ImgUtils::axisCoefficients(m_descrOrg.width, m_descrBase.width, ImgUtils::Area);
+    m_scaleY = ImgUtils::axisCoefficients(m_descrOrg.height, m_descrBase.height, ImgUtils::Area);
 }
 
-void MovementAnalyzer::scaleFrame(const FrameU8 &frame, const FrameDescr &descr, FrameU8 *outFrame) {
-    ImgUtils::resize(descr.width, descr.height,  descr.components, frame.data.data(), ImgUtils::DT_Uint8, ImgUtils::Pixel, 0,
-                     m_descrBase.width, m_descrBase.height, m_descrBase.components, outFrame->data.data(), ImgUtils::DT_Uint8, ImgUtils::Pixel, 0,
-                     false, nullptr, nullptr, nullptr, nullptr, nullptr);
+void MovementAnalyzer::makeProfiles(const FrameU8 &frame, Profiles &profiles) const
+{
+    // nearest input pixels of analysis grid - cheap, and noise is averaged by the profile itself
+    const uint32_t c = m_descrBase.components;
+    const uint32_t inRowSize = m_descrOrg.width*c;
+    auto nearest = [&frame, c, inRowSize, this] (uint32_t x, uint32_t y) {
+        const uint8_t* pixel = &frame.data[m_scaleY->begin[y]*inRowSize + m_scaleX->begin[x]*c];
+        uint32_t sum = 0;
+        for (uint32_t k = 0; k < c; ++k) {
+            sum += pixel[k];
+        }
+        return static_cast<float>(sum) / c;
+    };
+
+    const uint32_t w = m_descrBase.width;
+    const uint32_t h = m_descrBase.height;
+    profiles.columns.assign(PROFILE_BANDS*w, 0.0f);
+    profiles.rows.assign(PROFILE_BANDS*h, 0.0f);
+    const float bandRows = static_cast<float>(h) / (PROFILE_BANDS*PROFILE_STEP);
+    const float bandColumns = static_cast<float>(w) / (PROFILE_BANDS*PROFILE_STEP);
+    for (uint32_t y = 0; y < h; y += PROFILE_STEP) {
+        float* columns = &profiles.columns[(y*PROFILE_BANDS/h)*w];
+        for (uint32_t x = 0; x < w; ++x) {
+            columns[x] += nearest(x, y) / bandRows;
+        }
+    }
+    for (uint32_t y = 0; y < h; ++y) {
+        for (uint32_t x = 0; x < w; x += PROFILE_STEP) {
+            profiles.rows[(x*PROFILE_BANDS/w)*h + y] += nearest(x, y) / bandColumns;
+        }
+    }
 }
 
-void squareDiff(const FrameU8& src1, const FrameU8& src2, const FrameDescr &srcDescr, FrameU16 &out)
+int32_t MovementAnalyzer::estimateShift(const std::vector<float>& base, const std::vector<float>& next, uint32_t length, int32_t maxShift)
 {
-    #pragma omp for
-    for (uint32_t i = 0; i < static_cast<uint32_t>(src1.data.size()); i += srcDescr.components) {
-        uint32_t outPos = i / srcDescr.components;
-        out.data[outPos] = 0;
-        for (uint32_t c = 0; c < srcDescr.components; ++c) {
-            float diff = static_cast<float>(src1.data[i + c]) - src2.data[i + c];
-            out.data[outPos] += static_cast<uint16_t>(diff*diff);
+    // every profile is normalized (zero mean, unit deviation), so brightness change doesn't affect shift
+    auto normalize = [length] (const std::vector<float>& profiles, std::vector<float>& out) {
+        out.resize(profiles.size());
+        for (size_t begin = 0; begin < profiles.size(); begin += length) {
+            float mean = 0.0f;
+            for (size_t i = begin; i < begin + length; ++i) {
+                mean += profiles[i];
+            }
+            mean /= length;
+            float variance = 0.0f;
+            for (size_t i = begin; i < begin + length; ++i) {
+                variance += (profiles[i] - mean) * (profiles[i] - mean);
+            }
+            float deviation = std::max(1.0f, std::sqrt(variance / length)); // flat profile stays flat
+            for (size_t i = begin; i < begin + length; ++i) {
+                out[i] = (profiles[i] - mean) / deviation;
+            }
+        }
+    };
+
+    std::vector<float> b, n;
+    normalize(base, b);
+    normalize(next, n);
+
+    const int32_t size = static_cast<int32_t>(length);
+    auto cost = [&b, &n, size] (int32_t shift) {
+        float sum = 0.0f;
+        int32_t count = 0;
+        for (size_t begin = 0; begin < b.size(); begin += static_cast<size_t>(size)) {
+            for (int32_t i = std::max(0, shift); i < std::min(size, size + shift); ++i) {
+                sum += std::abs(n[begin + i] - b[begin + i - shift]);
+                ++count;
+            }
+        }
+        return count ? sum / count : std::numeric_limits<float>::max();
+    };
+
+    const float noShiftCost = cost(0);
+    float bestCost = noShiftCost;
+    int32_t bestShift = 0;
+    for (int32_t shift = -maxShift; shift <= maxShift; ++shift) {
+        float c = cost(shift);
+        if (c < bestCost) {
+            bestCost = c;
+            bestShift = shift;
         }
     }
+    // accept only clear improvement - moving object alone shouldn't shift whole frame
+    return bestCost < SHIFT_MIN_IMPROVEMENT * noShiftCost ? bestShift : 0;
+}
+
+float MovementAnalyzer::brightness(const FrameU8 &frame, uint32_t x, uint32_t y) const
+{
+    const uint32_t c = m_descrBase.components;
+    const uint32_t inRowSize = m_descrOrg.width*c;
+    const ImgUtils::AxisCoefficients& cx = *m_scaleX;
+    const ImgUtils::AxisCoefficients& cy = *m_scaleY;
+    const float* wx = &cx.weights[static_cast<size_t>(x)*cx.taps];
+    const float* wy = &cy.weights[static_cast<size_t>(y)*cy.taps];
+    float sum = 0.0f;
+    for (uint32_t ky = 0; ky < cy.taps; ++ky) {
+        const uint8_t* row = &frame.data[(cy.begin[y] + ky)*inRowSize + cx.begin[x]*c];
+        for (uint32_t kx = 0; kx < cx.taps; ++kx) {
+            const float w = wy[ky] * wx[kx];
+            for (uint32_t k = 0; k < c; ++k) {
+                sum += w * row[kx*c + k];
+            }
+        }
+    }
+    return sum / c;
+}
+
+void MovementAnalyzer::estimateCompensation(const FrameU8 &frame)
+{
+    Compensation& comp = m_compensation;
+    comp.shiftX = estimateShift(m_baseProfiles.columns, m_nextProfiles.columns, m_descrBase.width, m_maxShift);
+    comp.shiftY = estimateShift(m_baseProfiles.rows, m_nextProfiles.rows, m_descrBase.height, m_maxShift);
+
+    // gain and offset - next = gain * base + offset fitted on sparse grid of aligned pixels,
+    // refitted without outliers, so moving objects don't pull the estimation
+    std::vector<std::pair<float, float>> samples; // base, next
+    samples.reserve((m_descrBase.width / PROFILE_STEP + 1) * (m_descrBase.height / PROFILE_STEP + 1));
+    const uint32_t c = m_descrBase.components;
+    for (uint32_t y = PROFILE_STEP/2; y < m_descrBase.height; y += PROFILE_STEP) {
+        int32_t baseY = static_cast<int32_t>(y) - comp.shiftY;
+        if (baseY < 0 || baseY >= static_cast<int32_t>(m_descrBase.height)) {
+            continue;
+        }
+        for (uint32_t x = PROFILE_STEP/2; x < m_descrBase.width; x += PROFILE_STEP) {
+            int32_t baseX = static_cast<int32_t>(x) - comp.shiftX;
+            if (baseX < 0 || baseX >= static_cast<int32_t>(m_descrBase.width)) {
+                continue;
+            }
+            const uint8_t* basePixel = &m_baseFrame->data[(static_cast<uint32_t>(baseY)*m_descrBase.width + static_cast<uint32_t>(baseX))*c];
+            uint32_t baseSum = 0;
+            for (uint32_t k = 0; k < c; ++k) {
+                baseSum += basePixel[k];
+            }
+            samples.push_back({static_cast<float>(baseSum) / c, brightness(frame, x, y)});
+        }
+    }
+    if (samples.size() < 16) {
+        return;
+    }
+
+    double gain = 1.0;
+    double offset = 0.0;
+    float inlierLimit = std::numeric_limits<float>::max();
+    std::vector<float> residuals(samples.size());
+    for (uint32_t iteration = 0; iteration < 2; ++iteration) {
+        double sb = 0.0, sn = 0.0, sbb = 0.0, sbn = 0.0;
+        uint32_t count = 0;
+        for (size_t i = 0; i < samples.size(); ++i) {
+            if (iteration > 0 && std::abs(residuals[i]) > inlierLimit) {
+                continue;
+            }
+            double bv = samples[i].first;
+            double nv = samples[i].second;
+            sb += bv;
+            sn += nv;
+            sbb += bv*bv;
+            sbn += bv*nv;
+            ++count;
+        }
+        if (count < 16) {
+            break;
+        }
+        double variance = sbb - sb*sb/count;
+        gain = variance > count ? (sbn - sb*sn/count) / variance : 1.0; // flat image - only offset
+        if (gain < MIN_GAIN || gain > MAX_GAIN) {
+            gain = 1.0;
+        }
+        offset = (sn - gain*sb) / count;
+
+        for (size_t i = 0; i < samples.size(); ++i) {
+            residuals[i] = samples[i].second - static_cast<float>(gain*samples[i].first + offset);
+        }
+        std::vector<float> absResiduals(residuals.size());
+        std::transform(residuals.begin(), residuals.end(), absResiduals.begin(), [] (float r) { return std::abs(r); });
+        auto median = absResiduals.begin() + absResiduals.size() / 2;
+        std::nth_element(absResiduals.begin(), median, absResiduals.end());
+        inlierLimit = std::max(MIN_INLIER_LIMIT, 3.0f * 1.4826f * *median);
+    }
+
+    // sensor noise - small corrections are skipped, diff threshold covers them
+    if (std::abs(gain - 1.0) < MIN_GAIN_CHANGE && std::abs(offset) < MIN_OFFSET_CHANGE) {
+        return;
+    }
+    comp.gain = static_cast<float>(gain);
+    comp.offset = static_cast<float>(offset);
+}
+
+void MovementAnalyzer::scaleRow(const FrameU8 &frame, uint32_t y, std::vector<float>& rowSum, uint8_t* outRow) const
+{
+    // input rows are walked once, sequentially - weighted sums of all output pixels in the row are collected together
+    const ImgUtils::AxisCoefficients& cx = *m_scaleX;
+    const ImgUtils::AxisCoefficients& cy = *m_scaleY;
+    const uint32_t c = m_descrBase.components;
+    const uint32_t inRowSize = m_descrOrg.width*c;
+    const float* wy = &cy.weights[static_cast<size_t>(y)*cy.taps];
+    std::fill(rowSum.begin(), rowSum.end(), 0.0f);
+    for (uint32_t ky = 0; ky < cy.taps; ++ky) {
+        if (wy[ky] == 0.0f) {
+            continue;
+        }
+        const uint8_t* inRow = &frame.data[(cy.begin[y] + ky)*inRowSize];
+        for (uint32_t x = 0; x < m_descrBase.width; ++x) {
+            float* sum = &rowSum[x*c];
+            const float* wx = &cx.weights[static_cast<size_t>(x)*cx.taps];
+            const uint8_t* src = &inRow[cx.begin[x]*c];
+            for (uint32_t kx = 0; kx < cx.taps; ++kx) {
+                const float w = wy[ky] * wx[kx];
+                for (uint32_t k = 0; k < c; ++k) {
+                    sum[k] += w * src[kx*c + k];
+                }
+            }
+        }
+    }
+    for (uint32_t i = 0; i < m_descrBase.width*c; ++i) {
+        outRow[i] = static_cast<uint8_t>(rowSum[i] + 0.5f);
+    }
+}
+
+void MovementAnalyzer::scaleFrame(const FrameU8 &frame, FrameU8 *outFrame)
+{
+    const uint32_t outRowSize = m_descrBase.width*m_descrBase.components;
+    ThreadPool::shared().parallelFor(m_descrBase.height, m_maxThreads, [this, &frame, outFrame, outRowSize] (uint32_t yBegin, uint32_t yEnd, uint32_t strip) {
+        for (uint32_t y = yBegin; y < yEnd; ++y) {
+            scaleRow(frame, y, m_bandScratch[strip].rowSum, &outFrame->data[y*outRowSize]);
+        }
+    });
+}
+
+///
+/// \brief squareDiff - one streaming pass over rows [yBegin, yEnd): square difference, zeroing values under threshold
+///                      and counting changed pixels per tile (rows range has to be aligned to tiles) and per heatmap cell
+/// \param src1 - base frame, compensated when Compensate is true: pixel (x - shiftX, y - shiftY) * gain + offset
+///               pixels without base pixel (moved out of frame) are treated as not changed
+/// \param out - buffer for given rows only, first row of it is yBegin
+/// \return count of changed pixels in given rows
+///
+template<bool Compensate, typename Compensation>
+static uint32_t squareDiff(const FrameU8& src1, const FrameU8& src2, const FrameDescr &srcDescr, uint32_t zeroThreshold,
+                           const Compensation& comp, uint32_t yBegin, uint32_t yEnd,
+                           uint32_t tileSize, uint32_t tilesX, std::vector<uint32_t>& tileActivity, MotionHeatmap& heatmap, uint16_t* out)
+{
+    std::fill(&tileActivity[(yBegin / tileSize)*tilesX], &tileActivity[0] + ((yEnd + tileSize - 1) / tileSize)*tilesX, 0);
+    uint32_t totalActivity = 0;
+    const uint32_t components = srcDescr.components;
+    const int32_t width = static_cast<int32_t>(srcDescr.width);
+    const int32_t height = static_cast<int32_t>(srcDescr.height);
+    const int32_t gain = static_cast<int32_t>(comp.gain * 256.0f + 0.5f); // fixed point 8.8
+    const int32_t offset = static_cast<int32_t>(std::lround(comp.offset));
+    // next pixels x in [xBegin, xEnd) have base pixel
+    const uint32_t xBegin = Compensate ? static_cast<uint32_t>(std::clamp(comp.shiftX, 0, width)) : 0;
+    const uint32_t xEnd = Compensate ? static_cast<uint32_t>(std::clamp(width + comp.shiftX, 0, width)) : srcDescr.width;
+    for (uint32_t y = yBegin; y < yEnd; ++y) {
+        const int32_t baseY = Compensate ? static_cast<int32_t>(y) - comp.shiftY : static_cast<int32_t>(y);
+        uint16_t* outRow = &out[(y - yBegin)*srcDescr.width];
+        if (Compensate && (baseY < 0 || baseY >= height || xBegin >= xEnd)) {
+            std::fill(outRow, outRow + srcDescr.width, 0);
+            continue;
+        }
+        const int32_t baseShift = Compensate ? -comp.shiftX : 0;
+        const uint8_t* row1 = &src1.data[static_cast<uint32_t>(baseY)*srcDescr.width*components];
+        const uint8_t* row2 = &src2.data[y*srcDescr.width*components];
+        uint32_t* tileRow = &tileActivity[(y / tileSize)*tilesX];
+        uint8_t* hitsRow = heatmap.hitsRow(y);
+        std::fill(outRow, outRow + xBegin, 0);
+        std::fill(outRow + xEnd, outRow + srcDescr.width, 0);
+        for (uint32_t x = xBegin; x < xEnd; ++x) {
+            const uint8_t* basePixel = &row1[static_cast<uint32_t>(static_cast<int32_t>(x) + baseShift)*components];
+            uint32_t sum = 0;
+            for (uint32_t c = 0; c < components; ++c) {
+                int32_t base = basePixel[c];
+                if (Compensate) {
+                    base = std::clamp(((base*gain + 128) >> 8) + offset, 0, 255);
+                }
+                int32_t diff = base - row2[x*components + c];
+                sum += static_cast<uint32_t>(diff*diff);
+            }
+            if (sum <= zeroThreshold) {
+                outRow[x] = 0;
+            }
+            else {
+                outRow[x] = static_cast<uint16_t>(std::min<uint32_t>(sum, std::numeric_limits<uint16_t>::max()));
+                ++tileRow[x / tileSize];
+                if (hitsRow) {
+                    ++hitsRow[x >> MotionHeatmap::CELL_SHIFT];
+                }
+                ++totalActivity;
+            }
+        }
+    }
+    return totalActivity;
+}
+
+static uint32_t findRoot(std::vector<uint32_t>& parent, uint32_t label)
+{
+    while (parent[label] != label) {
+        parent[label] = parent[parent[label]]; // path halving
+        label = parent[label];
+    }
+    return label;
+}
+
+static void uniteRegions(std::vector<uint32_t>& parent, uint32_t a, uint32_t b)
+{
+    a = findRoot(parent, a);
+    b = findRoot(parent, b);
+    if (a < b) {
+        parent[b] = a;
+    }
+    else if (b < a) {
+        parent[a] = b;
+    }
 }
 
 /*
@@ -184,214 +633,274 @@ static void saveU8(const char* name, const FrameU8& f, const FrameDescr& descr)
 }
 */
 
-void MovementAnalyzer::analyzeMovement()
+void MovementAnalyzer::streamFrame(const FrameU8 &frame)
 {
-    squareDiff(*m_baseFrame, *m_nextFrame, m_descrBase, m_cache[0]);
-    //saveU8("base", *m_baseFrame, m_descrBase);
-    //saveU8("next", *m_nextFrame, m_descrBase);
+    // Band by band (one tile row): downscale, diff against base and label regions inside the band.
+    // Only band scratch of every thread is written - there is no full size diff/label image.
+    auto beginTime = std::chrono::steady_clock::now();
+    m_compensation = Compensation();
+    if (m_compensationEnabled) {
+        makeProfiles(frame, m_nextProfiles);
+        estimateCompensation(frame);
+    }
+    auto compensationTime = std::chrono::steady_clock::now();
 
-    const uint16_t zeroThreshold = uint16_t(10*10 * m_descrBase.components); // each component square diff is lower than 5^2
-    #pragma omp for
-    for (size_t i = 0; i < m_cache[0].data.size(); ++i)
-    {
-        if (m_cache[0].data[i] <= zeroThreshold)
-        {
-            m_cache[0].data[i] = 0;
+    for (BandScratch& scratch : m_bandScratch) {
+        scratch.times = StageTimes();
+    }
+    std::atomic<uint32_t> totalActivity{0};
+    ThreadPool::shared().parallelFor(m_tilesY, m_maxThreads, [this, &frame, &totalActivity] (uint32_t tyBegin, uint32_t tyEnd, uint32_t strip) {
+        uint32_t activity = 0;
+        for (uint32_t ty = tyBegin; ty < tyEnd; ++ty) {
+            activity += processBand(frame, ty, m_bandScratch[strip]);
         }
+        totalActivity += activity;
+    });
+    m_totalActivity = totalActivity;
+
+    m_stageTimes = StageTimes();
+    m_stageTimes.compensation = std::chrono::duration<double>(compensationTime - beginTime).count();
+    for (const BandScratch& scratch : m_bandScratch) {
+        m_stageTimes.resize += scratch.times.resize;
+        m_stageTimes.diff += scratch.times.diff;
+        m_stageTimes.labeling += scratch.times.labeling;
     }
+    std::chrono::duration<double> bandPassTime = std::chrono::steady_clock::now() - beginTime;
+    m_bandPassTime = bandPassTime.count();
+}
 
-    //saveU16("smplified", m_cache[0]);
+uint32_t MovementAnalyzer::processBand(const FrameU8 &frame, uint32_t ty, BandScratch& scratch)
+{
+    using Clock = std::chrono::steady_clock;
+    auto elapsed = [] (const Clock::time_point& from, const Clock::time_point& to) {
+        return std::chrono::duration<double>(to - from).count();
+    };
+
+    const uint32_t yBegin = ty*TILE_SIZE;
+    const uint32_t yEnd = std::min(yBegin + TILE_SIZE, m_descrBase.height);
+    const uint32_t rowSize = m_descrBase.width*m_descrBase.components;
+
+    auto beginTime = Clock::now();
+    for (uint32_t y = yBegin; y < yEnd; ++y) {
+        scaleRow(frame, y, scratch.rowSum, &m_nextFrame->data[y*rowSize]);
+    }
+    auto scaledTime = Clock::now();
+
+    const uint32_t zeroThreshold = 10*10 * m_descrBase.components; // each component square diff is lower than 10^2
+    uint32_t activity = m_compensation.isIdentity()
+                      ? squareDiff<false>(*m_baseFrame, *m_nextFrame, m_descrBase, zeroThreshold, m_compensation, yBegin, yEnd,
+                                          TILE_SIZE, m_tilesX, m_tileActivity, m_heatmap, scratch.labels.data())
+                      : squareDiff<true>(*m_baseFrame, *m_nextFrame, m_descrBase, zeroThreshold, m_compensation, yBegin, yEnd,
+                                         TILE_SIZE, m_tilesX, m_tileActivity, m_heatmap, scratch.labels.data());
+    auto diffTime = Clock::now();
+
+    labelTileRow(ty, scratch.labels.data());
+    LabelBlock& block = m_labelBlocks[ty];
+    const uint16_t* lastRow = &scratch.labels[(yEnd - 1 - yBegin)*m_descrBase.width];
+    std::copy(scratch.labels.begin(), scratch.labels.begin() + m_descrBase.width, block.firstRow.begin());
+    std::copy(lastRow, lastRow + m_descrBase.width, block.lastRow.begin());
+    auto labelTime = Clock::now();
+
+    scratch.times.resize += elapsed(beginTime, scaledTime);
+    scratch.times.diff += elapsed(scaledTime, diffTime);
+    scratch.times.labeling += elapsed(diffTime, labelTime);
+    return activity;
+}
 
-    makeRegions();
+bool MovementAnalyzer::analyzeMovement(const std::chrono::steady_clock::time_point& frameTime)
+{
+    using Clock = std::chrono::steady_clock;
+    auto elapsed = [] (const Clock::time_point& from, const Clock::time_point& to) {
+        return std::chrono::duration<double>(to - from).count();
+    };
+    //saveU8("base", *m_baseFrame, m_descrBase);
+    //saveU8("next", *m_nextFrame, m_descrBase);
 
-    for (const auto &countPair : m_regions) {
-        if (countPair.second >= REGION_THRESHOLD) {
-            notifyAboutMovementDetected();
-            break;
-        }
+    bool movementDetected = false;
+    m_regions.clear();
+    m_movementBoxes.clear();
+
+    // whole image changed even after compensation - exposure/IR switch, not movement
+    // no log here - flickering light would flood it, frames are counted in Metrics::exposureChanges
+    m_exposureChange = m_totalActivity > m_exposureChangeArea * m_descrBase.width * m_descrBase.height;
+    if (!m_exposureChange && m_totalActivity >= REGION_THRESHOLD) { // otherwise even all changed pixels connected together can't make big enough region
+        auto beginTime = Clock::now();
+        makeRegions();
+        m_stageTimes.labeling += elapsed(beginTime, Clock::now());
+
+        movementDetected = std::any_of(m_regions.begin(), m_regions.end(),
+                                       [] (const auto& regionPair) { return regionPair.second.count >= REGION_THRESHOLD; });
+        makeMovementBoxes();
+    }
+
+    // hits of exposure change or small noise are dropped
+    // heat decay and trigger windows follow frame time - replayed frames come much faster than real time
+    m_heatmap.commit(movementDetected, m_tileActivity, m_tilesX, TILE_SIZE, frameTime);
+
+    // every sample goes through filter - also these without movement, as they build trigger history
+    auto filterTime = Clock::now();
+    if (m_triggerFilter.update(movementDetected, m_movementBoxes, frameTime)) {
+        notifyAboutMovementDetected();
+        m_stageTimes.notification = elapsed(filterTime, Clock::now());
     }
+    return movementDetected;
 }
 
 void MovementAnalyzer::makeRegions()
 {
     m_regions.clear();
-    std::map<uint16_t, uint32_t> localRegions; // key = regionId, value = pixel count
-    std::map<uint16_t, std::set<uint16_t>> regionsConnections; // key = regionId, value = master region
-    uint16_t newRegionId = 1;
-
-    auto& squareDiffImg = m_cache[0].data;
-    // first element
-    if (squareDiffImg[0] > 0) {
-        squareDiffImg[0] = newRegionId;
-        localRegions[newRegionId] = 1;
-        ++newRegionId;
-    }
-    // first line
-    for (uint32_t x = 1; x < m_descrBase.width; ++x) {
-        if (squareDiffImg[x] > 0) {
-            if (squareDiffImg[x-1] > 0) {
-                uint16_t prevRegion = squareDiffImg[x-1];
-                squareDiffImg[x] = prevRegion;
-                localRegions[prevRegion] += 1;
-            }
-            else {
-                squareDiffImg[x] = newRegionId;
-                localRegions[newRegionId] = 1;
-                ++newRegionId;
-            }
+
+    // every tile row is already labeled by band pass, labels are unique only inside the tile row
+    // merge - move local labels into one global space and connect regions across tile row borders
+    std::vector<uint32_t> labelOffset(m_tilesY, 0);
+    uint32_t labelsCount = 0;
+    for (uint32_t ty = 0; ty < m_tilesY; ++ty) {
+        labelOffset[ty] = labelsCount;
+        labelsCount += static_cast<uint32_t>(m_labelBlocks[ty].parent.size());
+    }
+    m_globalParent.resize(labelsCount);
+    for (uint32_t ty = 0; ty < m_tilesY; ++ty) {
+        const auto& localParent = m_labelBlocks[ty].parent;
+        for (uint32_t l = 0; l < localParent.size(); ++l) {
+            m_globalParent[labelOffset[ty] + l] = labelOffset[ty] + localParent[l];
         }
     }
 
-    // rest elements
-    for (uint32_t y = 1; y < m_descrBase.height; ++y) {
-        uint32_t pixelRow = y * m_descrBase.width;
-        uint32_t pixelUpRow = pixelRow - m_descrBase.width;
-
-        if (squareDiffImg[pixelRow] > 0) {
-            if (squareDiffImg[pixelUpRow] > 0) {
-                uint16_t prevRegion = squareDiffImg[pixelUpRow];
-                squareDiffImg[pixelRow] = prevRegion;
-                localRegions[prevRegion] += 1;
+    for (uint32_t ty = 1; ty < m_tilesY; ++ty) {
+        const uint16_t* row = m_labelBlocks[ty].firstRow.data();
+        const uint16_t* upRow = m_labelBlocks[ty-1].lastRow.data();
+        for (uint32_t x = 0; x < m_descrBase.width; ++x) {
+            uint16_t label = row[x];
+            if (!label) {
+                continue;
             }
-            else {
-                squareDiffImg[pixelRow] = newRegionId;
-                localRegions[newRegionId] = 1;
-                ++newRegionId;
+            // the same neighbourhood as inside tile row: up and up-left
+            uint16_t upLabel = upRow[x];
+            uint16_t upPrevLabel = x > 0 ? upRow[x - 1] : 0;
+            if (upLabel) {
+                uniteRegions(m_globalParent, labelOffset[ty] + label, labelOffset[ty-1] + upLabel);
             }
-        }
-
-        for (uint32_t x = 1; x < m_descrBase.width; ++x) {
-            uint32_t pixelPos = pixelRow + x;
-            if (squareDiffImg[pixelPos] > 0) {
-                uint16_t prevRegion   = squareDiffImg[pixelPos-1];
-                uint16_t upRegion     = squareDiffImg[pixelUpRow + x];
-                uint16_t upPrevRegion = squareDiffImg[pixelUpRow + x - 1];
-                if (prevRegion > 0 || upRegion > 0 || upPrevRegion > 0) {
-                    uint16_t useRegion = upPrevRegion > 0 ? upPrevRegion :
-                                        (upRegion     > 0 ? upRegion
-                                                          : prevRegion);
-                    if (upRegion > 0) {
-                        if (useRegion != upRegion) {
-                            regionsConnections[useRegion].insert(upRegion);
-                            regionsConnections[upRegion].insert(useRegion);
-                        }
-                    }
-
-                    if (prevRegion > 0) {
-                        if (useRegion != prevRegion) {
-                            regionsConnections[useRegion].insert(prevRegion);
-                            regionsConnections[prevRegion].insert(useRegion);
-                        }
-                    }
-
-                    squareDiffImg[pixelPos] = useRegion;
-                    localRegions[useRegion] += 1;
-                }
-                else {
-                    squareDiffImg[pixelPos] = newRegionId;
-                    localRegions[newRegionId] = 1;
-                    ++newRegionId;
-                }
+            if (upPrevLabel) {
+                uniteRegions(m_globalParent, labelOffset[ty] + label, labelOffset[ty-1] + upPrevLabel);
             }
         }
     }
 
     // sum connected regions
-    for (auto& connection : regionsConnections) {
-        auto currentRegion = connection.first;
-        uint32_t &currentCount = localRegions[currentRegion];
-        auto& connectedSet = connection.second;
-        std::vector<decltype(currentRegion)> connectedList;
-        connectedList.reserve(connectedSet.size() + connectedSet.size()/2); // assume 50% more mem
-        for (auto it = connectedSet.begin(); it != connectedSet.end(); ++it) {
-            connectedList.push_back(*it);
-        }
-        for (uint32_t i = 0; i < connectedList.size(); ++i) {
-            auto neighbourRegion = connectedList[i];
-            auto & yourRegions = regionsConnections[neighbourRegion];
-
-            // your regions became my regions - you will be connected only with me
-            for (auto it = yourRegions.begin(); it != yourRegions.end();) {
-                if (*it == currentRegion) {
-                    ++it;
-                    continue;
-                }
-                if (connectedSet.find(*it) == connectedSet.end()) { // take only new connections
-                    connectedSet.insert(*it);
-                    connectedList.push_back(*it);
-                }
-                it = yourRegions.erase(it);
-            }
-
-            if (yourRegions.empty()) { // your are neighbour of my neighbours, but until now I haven't know you
-                yourRegions.insert(currentRegion);
+    for (uint32_t ty = 0; ty < m_tilesY; ++ty) {
+        const auto& localStats = m_labelBlocks[ty].stats;
+        for (uint32_t l = 1; l < localStats.size(); ++l) { // label 0 is background
+            if (localStats[l].count) {
+                m_regions[findRoot(m_globalParent, labelOffset[ty] + l)].add(localStats[l]);
             }
-
-            uint32_t &neighbourCount = localRegions[neighbourRegion];
-            currentCount += neighbourCount;
-            neighbourCount = 0;
-        }
-    } 
-    // take only positive
-    for (const auto &countPair : localRegions) {
-        if (countPair.second > 0) {
-            m_regions.insert(countPair);
         }
     }
+}
 
-    // debug
-    /*
-    {
-        if(m_regions.empty())
-        {
-            return;
-        }
-
-        // repaint connected
-        for (auto& pix : squareDiffImg) {
-            if (pix) {
-                if (localRegions[pix] == 0) {
-                    // sanity check
-                    const auto& connections = regionsConnections[pix];
-                    if (connections.size() != 1) {
-                        std::cout << "Impossible!!!\n";
-                        std::cout.flush();
-                        std::abort();
-                    }
-                    pix = *connections.begin();
-                }
-            }
+void MovementAnalyzer::makeMovementBoxes()
+{
+    m_movementBoxes.clear();
+    const float w = static_cast<float>(m_descrBase.width);
+    const float h = static_cast<float>(m_descrBase.height);
+    for (const auto &regionPair : m_regions) {
+        const RegionStats& region = regionPair.second;
+        if (region.count < BOX_REGION_THRESHOLD) {
+            continue;
         }
+        // scaled frame is not proportional, but relative coordinates are the same as in original frame
+        m_movementBoxes.push_back(BoxUtils::fromEdges(region.minX / w, region.minY / h,
+                                                      (region.maxX + 1) / w, (region.maxY + 1) / h));
+    }
+    BoxUtils::mergeTouching(m_movementBoxes, BOX_MERGE_MARGIN / w, BOX_MERGE_MARGIN / h);
+}
+
+void MovementAnalyzer::RegionStats::add(uint32_t x, uint32_t y)
+{
+    ++count;
+    minX = std::min(minX, x);
+    minY = std::min(minY, y);
+    maxX = std::max(maxX, x);
+    maxY = std::max(maxY, y);
+}
+
+void MovementAnalyzer::RegionStats::add(const RegionStats& other)
+{
+    count += other.count;
+    minX = std::min(minX, other.minX);
+    minY = std::min(minY, other.minY);
+    maxX = std::max(maxX, other.maxX);
+    maxY = std::max(maxY, other.maxY);
+}
 
-        std::map<uint32_t, uint16_t> sortedSize;
-        for (const auto &countPair : m_regions) {
-            sortedSize.insert(std::make_pair(countPair.second, countPair.first));
+void MovementAnalyzer::labelTileRow(uint32_t ty, uint16_t* labels)
+{
+    LabelBlock& block = m_labelBlocks[ty];
+    block.parent.assign(1, 0); // label 0 is background
+    block.stats.assign(1, RegionStats());
+
+    // Pixels of tiles without activity are already zeroed by the diff pass, so labeling them
+    // can't change anything - walk only spans of active tiles.
+    const uint32_t* tileRow = &m_tileActivity[ty*m_tilesX];
+    const uint32_t yBegin = ty*TILE_SIZE;
+    const uint32_t yEnd = std::min(yBegin + TILE_SIZE, m_descrBase.height);
+    for (uint32_t tx = 0; tx < m_tilesX;) {
+        if (!tileRow[tx]) {
+            ++tx;
+            continue;
+        }
+        uint32_t txEnd = tx + 1;
+        while (txEnd < m_tilesX && tileRow[txEnd]) {
+            ++txEnd;
         }
-        std::map<uint16_t, uint8_t> regionToColor;
-        uint8_t currentColor = 255;
-        for (auto it = sortedSize.end(); it != sortedSize.begin() && currentColor >= 20;) {
-            --it;
-            regionToColor[it->second] = currentColor;
-            currentColor -= 20;
+        const uint32_t xBegin = tx*TILE_SIZE;
+        const uint32_t xEnd = std::min(txEnd*TILE_SIZE, m_descrBase.width);
+        for (uint32_t y = yBegin; y < yEnd; ++y) {
+            labelSpan(y, yBegin, xBegin, xEnd, labels, block);
         }
+        tx = txEnd;
+    }
+}
 
-        FrameU8 b;
-        b.data.resize(squareDiffImg.size(), 0);
-        for (uint32_t i = 0; i < b.data.size(); ++i) {
-            if (squareDiffImg[i]) {
-                auto colorIt = regionToColor.find(squareDiffImg[i]);
-                b.data[i] = colorIt != regionToColor.end() ? colorIt->second : 0;
-            }
+void MovementAnalyzer::labelSpan(uint32_t y, uint32_t firstRow, uint32_t xBegin, uint32_t xEnd, uint16_t* labels, LabelBlock& block)
+{
+    // spans are visited in raster order, so left and upper neighbours are already labeled
+    // or they are zero (not active)
+    uint16_t* squareDiffImg = labels; // first row of buffer is firstRow
+    const uint32_t pixelRow = (y - firstRow) * m_descrBase.width;
+    const uint32_t pixelUpRow = pixelRow - m_descrBase.width; // not used for first row
+    const bool hasUpRow = y > firstRow; // upper tile row belongs to another block - connected during merge
+
+    for (uint32_t x = xBegin; x < xEnd; ++x) {
+        uint32_t pixelPos = pixelRow + x;
+        if (squareDiffImg[pixelPos] == 0) {
+            continue;
         }
+        uint16_t prevRegion   = x > 0               ? squareDiffImg[pixelPos-1] : 0;
+        uint16_t upRegion     = hasUpRow            ? squareDiffImg[pixelUpRow + x] : 0;
+        uint16_t upPrevRegion = hasUpRow && x > 0   ? squareDiffImg[pixelUpRow + x - 1] : 0;
+        if (prevRegion > 0 || upRegion > 0 || upPrevRegion > 0) {
+            uint16_t useRegion = upPrevRegion > 0 ? upPrevRegion :
+                                (upRegion     > 0 ? upRegion
+                                                  : prevRegion);
+            if (upRegion > 0 && upRegion != useRegion) {
+                uniteRegions(block.parent, useRegion, upRegion);
+            }
+            if (prevRegion > 0 && prevRegion != useRegion) {
+                uniteRegions(block.parent, useRegion, prevRegion);
+            }
 
-        std::stringstream ss;
-        uint32_t w = 512;
-        uint32_t h = 512;
-        ss << "/tmp/MovementAnalyzer_" << w << "x" << h << "_" << "regions";
-        std::string fName = ss.str();
-        PngTools::writePngFile(fName.c_str(), w, h, 1, b.data.data());
+            squareDiffImg[pixelPos] = useRegion;
+            block.stats[useRegion].add(x, y);
+        }
+        else {
+            uint32_t newRegionId = static_cast<uint32_t>(block.parent.size());
+            assert(newRegionId <= std::numeric_limits<uint16_t>::max());
+            block.parent.push_back(newRegionId);
+            block.stats.emplace_back();
+            block.stats.back().add(x, y);
+            squareDiffImg[pixelPos] = static_cast<uint16_t>(newRegionId);
+        }
     }
-    */
 }
 
 void MovementAnalyzer::notifyAboutMovementDetected()
@@ -400,6 +909,6 @@ void MovementAnalyzer::notifyAboutMovementDetected()
     for (const auto& tuple : m_movementDetectedListener) {
         void* ctx = std::get<0>(tuple);
         OnMovementDetected func = std::get<1>(tuple);
-        func(m_nextFrame->nr, m_nextFrame->bufferIdx, ctx);
+        func(m_nextFrame->nr, m_nextFrame->bufferIdx, m_movementBoxes, ctx);
     }
 }
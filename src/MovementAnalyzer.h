@@ -17,9 +17,15 @@
 #pragma once
 
 #include "Frame.h"
+#include "Config.h"
+#include "BoxUtils.h"
+#include "TriggerFilter.h"
+#include "MotionHeatmap.h"
 #include <chrono>
 #include <array>
 #include <map>
+#include <memory>
+#include <vector>
 #include <thread>
 #include <mutex>
 #include <condition_variable>
@@ -28,41 +34,210 @@
 class MovementAnalyzer
 {
 public:
-    using OnMovementDetected = std::function<void(uint64_t frameNumber, uint32_t mainBufferIdx, void* ctx)>;
+    ///
+    /// \param regions - merged boxes of moving regions, relative to frame
+    ///
+    using OnMovementDetected = std::function<void(uint64_t frameNumber, uint32_t mainBufferIdx, const std::vector<DetectionBox>& regions, void* ctx)>;
 
-    MovementAnalyzer();
+    ///
+    /// \brief Metrics - state of adaptive sampling, refreshed after every analyzed frame
+    ///
+    struct Metrics {
+        double interval = 0.0;            // [s] current time between analyzed frames
+        double sampleRate = 0.0;          // [Hz] measured rate of analyzed frames
+        double analysisLatency = 0.0;     // [s] average time of one analysis
+        double lastAnalysisLatency = 0.0; // [s]
+        uint64_t analyzedFrames = 0;
+        uint64_t busySkippedFrames = 0;   // frames which were due to be analyzed, but previous analysis was still running
+        uint64_t exposureChanges = 0;     // frames where whole image changed - not treated as movement
+        TriggerFilter::Counters triggers; // reported and suppressed triggers
+        bool motionOngoing = false;
+        // global change compensated in last analyzed frame
+        float gain = 1.0f;
+        float offset = 0.0f;
+        int32_t shiftX = 0; // [px] of analysis resolution
+        int32_t shiftY = 0;
+    };
+
+    ///
+    /// \brief StageTimes - duration of analysis stages of one frame [s]
+    ///                     resize, diff and labeling run fused band by band on several threads - their times are summed over threads
+    ///
+    struct StageTimes {
+        double compensation = 0.0; // global illumination and shift estimation
+        double resize = 0.0;
+        double diff = 0.0;
+        double labeling = 0.0;
+        double notification = 0.0; // boxes preparation and listeners
+    };
+
+    MovementAnalyzer(const Config& cfg);
     ~MovementAnalyzer();
 
+    ///
+    /// \brief feedAnalyzer - takes frame when sampling interval passed and analysis thread is free
+    ///                       Analysis thread is started by first call.
+    ///
     void feedAnalyzer(const FrameU8 &frame, const FrameDescr& descr);
 
+    ///
+    /// \brief analyzeFrame - synchronous analysis of frame against previous one, in caller thread and without any throttling
+    ///                       Listeners are notified before return (when trigger passes TriggerFilter). Can't be mixed with feedAnalyzer.
+    ///                       frame.time drives trigger windows, zone cooldown and heatmap decay - it has to be set also for replayed frames.
+    /// \param times - optional, filled with durations of analysis stages
+    /// \return true when movement was detected in this frame, even if trigger was suppressed
+    ///
+    bool analyzeFrame(const FrameU8 &frame, const FrameDescr& descr, StageTimes* times = nullptr);
+
+    Metrics getMetrics() const;
+    const MotionHeatmap& getHeatmap() const { return m_heatmap; }
+
     void subscribeOnMovementDetected(OnMovementDetected notifyFunc, void* ctx = nullptr);
     void unsubscribeOnMovementDetected(OnMovementDetected notifyFunc, void* ctx = nullptr);
 private:
 
+    void startCalculationThread();
+    bool resetBaseFrame(const FrameU8 &frame, const FrameDescr &descr); // returns true when frame format has changed
     void allocateMem();
-    void scaleFrame(const FrameU8 &frame, const FrameDescr &descr, FrameU8 *outFrame);
-    void analyzeMovement();
+    void scaleFrame(const FrameU8 &frame, FrameU8 *outFrame);
+    void streamFrame(const FrameU8 &frame);
+    void swapBase();
+    bool analyzeMovement(const std::chrono::steady_clock::time_point& frameTime); // returns true when movement was detected
+    void updateSchedule(bool movementDetected, double latency, const std::chrono::steady_clock::time_point& analysisBegin);
     void makeRegions();
+    void makeMovementBoxes();
+
+    struct RegionStats {
+        uint32_t count = 0; // pixel count
+        uint32_t minX = UINT32_MAX;
+        uint32_t minY = UINT32_MAX;
+        uint32_t maxX = 0;
+        uint32_t maxY = 0;
+
+        void add(uint32_t x, uint32_t y);
+        void add(const RegionStats& other);
+    };
+
+    // labels of one tile row - union-find, index = local region id
+    struct LabelBlock {
+        std::vector<uint32_t> parent;
+        std::vector<RegionStats> stats;
+        std::vector<uint16_t> firstRow; // labels of border rows - needed to connect regions with neighbour tile rows
+        std::vector<uint16_t> lastRow;
+    };
+
+    // working memory of one thread of the band pass, small enough to stay in cache
+    struct BandScratch {
+        std::vector<float> rowSum;      // one downscaled row before rounding
+        std::vector<uint16_t> labels;   // TILE_SIZE rows of diff marks, then labels
+        StageTimes times;
+    };
+    // Global change between frames (exposure, camera shake), estimated from brightness profiles before diff:
+    // next pixel (x, y) is compared with base pixel (x - shiftX, y - shiftY) * gain + offset
+    struct Compensation {
+        int32_t shiftX = 0;
+        int32_t shiftY = 0;
+        float gain = 1.0f;
+        float offset = 0.0f;
+
+        bool isIdentity() const { return shiftX == 0 && shiftY == 0 && gain == 1.0f && offset == 0.0f; }
+    };
+
+    // Average brightness of every column (over sampled rows) and every row (over sampled columns).
+    // Frame is split into PROFILE_BANDS bands, every band has own profile - whole frame average would blur the texture.
+    struct Profiles {
+        std::vector<float> columns; // PROFILE_BANDS * width
+        std::vector<float> rows;    // PROFILE_BANDS * height
+    };
+    void makeProfiles(const FrameU8 &frame, Profiles& profiles) const;
+    void estimateCompensation(const FrameU8 &frame);
+    static int32_t estimateShift(const std::vector<float>& base, const std::vector<float>& next, uint32_t length, int32_t maxShift);
+    float brightness(const FrameU8 &frame, uint32_t x, uint32_t y) const; // average of downscaling box
+
+    void scaleRow(const FrameU8 &frame, uint32_t y, std::vector<float>& rowSum, uint8_t* outRow) const;
+    uint32_t processBand(const FrameU8 &frame, uint32_t ty, BandScratch& scratch);
+    void labelTileRow(uint32_t ty, uint16_t* labels);
+    void labelSpan(uint32_t y, uint32_t firstRow, uint32_t xBegin, uint32_t xEnd, uint16_t* labels, LabelBlock& block);
     void notifyAboutMovementDetected();
 
     FrameU8 *m_baseFrame = nullptr;
     FrameU8 *m_nextFrame = nullptr;
     std::array<FrameU8, 2> m_cacheBase;
-    std::array<FrameU16, 1> m_cache;
+
+    // Downscale taps - output pixel is area average of input pixels it covers.
+    std::shared_ptr<const ImgUtils::AxisCoefficients> m_scaleX;
+    std::shared_ptr<const ImgUtils::AxisCoefficients> m_scaleY;
+
+    std::vector<BandScratch> m_bandScratch; // one per thread
+
+    double m_bandPassTime = 0.0; // [s] wall time of last band pass
+
+    // Coarse activity histogram filled by the diff pass - count of changed pixels per tile.
+    // Tiles without activity are skipped by labeling.
+    std::vector<uint32_t> m_tileActivity;
+    uint32_t m_tilesX = 0;
+    uint32_t m_tilesY = 0;
+    uint32_t m_totalActivity = 0;
+
+    std::vector<LabelBlock> m_labelBlocks; // one per tile row
+    std::vector<uint32_t> m_globalParent;
+
+    uint32_t m_maxThreads = 0; // threads of shared pool used by analysis, 0 - all
 
     FrameDescr m_descrOrg;
     FrameDescr m_descrBase;
 
     std::chrono::time_point<std::chrono::steady_clock> m_firstFrameTime;
 
-    static constexpr double TIME_BETWEEN_FRAMES = 0.3; // [s]
+    // Adaptive sampling: interval drops to m_minInterval when movement is detected and grows up to m_maxInterval
+    // when scene stays idle. Analysis cost (latency * used threads) can't exceed m_cpuBudget part of one core.
+    double m_minInterval;    // [s]
+    double m_maxInterval;    // [s]
+    double m_cpuBudget;      // [cores]
+    double m_activityInterval = TIME_BETWEEN_FRAMES; // [s] interval driven by scene activity only
+    double m_interval = TIME_BETWEEN_FRAMES;         // [s] interval used by feedAnalyzer, guarded by m_waitForCalculationTaskMtx
+    uint32_t m_idleSamples = 0;
+    std::chrono::time_point<std::chrono::steady_clock> m_lastAnalysisBegin;
+
+    bool m_compensationEnabled;
+    int32_t m_maxShift;         // [px] of analysis resolution
+    float m_exposureChangeArea; // part of frame - bigger change is treated as exposure change
+    Profiles m_baseProfiles;
+    Profiles m_nextProfiles;
+    Compensation m_compensation; // for current m_nextFrame
+    bool m_exposureChange = false;
+
+    mutable std::mutex m_metricsMtx;
+    Metrics m_metrics;
+
+    static constexpr double TIME_BETWEEN_FRAMES = 0.3; // [s] default and starting interval
+    static constexpr uint32_t IDLE_SAMPLES_BEFORE_BACKOFF = 10;
+    static constexpr double BACKOFF_FACTOR = 1.25;
+    static constexpr double METRICS_SMOOTHING = 0.1; // weight of newest sample in averages
+    static constexpr uint32_t PROFILE_STEP = 8; // [px] every PROFILE_STEP row/column is sampled for profiles and gain
+    static constexpr uint32_t PROFILE_BANDS = 8;
+    static constexpr float SHIFT_MIN_IMPROVEMENT = 0.9f; // shifted profiles have to match at least that much better
+    static constexpr double MIN_GAIN = 0.25;
+    static constexpr double MAX_GAIN = 4.0;
+    static constexpr double MIN_GAIN_CHANGE = 0.02;
+    static constexpr double MIN_OFFSET_CHANGE = 2.0;
+    static constexpr float MIN_INLIER_LIMIT = 4.0f; // brightness difference still treated as global change
     static constexpr uint32_t PREFERED_SIZE = 512;
     static constexpr uint32_t REGION_THRESHOLD = 50*30;
+    static constexpr uint32_t TILE_SIZE = 32; // [px] PREFERED_SIZE / TILE_SIZE = 16 tiles per dimension
+    static constexpr uint32_t BOX_REGION_THRESHOLD = REGION_THRESHOLD / 4; // smaller regions are not reported as boxes
+    static constexpr uint32_t BOX_MERGE_MARGIN = TILE_SIZE; // [px] boxes closer than margin are merged
+    static_assert(TILE_SIZE % (1u << MotionHeatmap::CELL_SHIFT) == 0, "Heatmap cells can't cross tiles");
 
-    std::map<uint16_t, uint32_t> m_regions; // key = regionId, value = pixel count
+    StageTimes m_stageTimes; // of last analysis
+    std::map<uint32_t, RegionStats> m_regions; // key = regionId
+    std::vector<DetectionBox> m_movementBoxes;
+    TriggerFilter m_triggerFilter; // used only by analysis
+    MotionHeatmap m_heatmap;       // hits filled by band pass, committed by analysis
 
-    volatile bool m_threadIsRunning = true;
-    volatile bool m_newTask = false;
+    // both guarded by m_waitForCalculationTaskMtx
+    bool m_threadIsRunning = true;
+    bool m_newTask = false;
     std::mutex m_waitForCalculationTaskMtx;
     std::condition_variable m_waitForCalculationTaskCv;
     std::thread m_calculationThread;
@@ -0,0 +1,208 @@
+//
+// The MIT License (MIT)
+//
+// Copyright 2020 Karolpg
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), 
+// to deal in the Software without restriction, including without limitation the rights to #use, copy, modify, merge, publish, distribute, sublicense, 
+// and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR #COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, 
+// WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+
+#include "ObjectTracker.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+double seconds(const ObjectTracker::Clock::time_point& from, const ObjectTracker::Clock::time_point& to)
+{
+    std::chrono::duration<double> d = to - from;
+    return d.count();
+}
+
+} // namespace
+
+DetectionBox ObjectTracker::Track::predict(const Clock::time_point& time) const
+{
+    float dt = static_cast<float>(seconds(lastVerified, time));
+    DetectionBox predicted = box;
+    predicted.x += vx * dt;
+    predicted.y += vy * dt;
+    return predicted;
+}
+
+ObjectTracker::ObjectTracker(const Config& cfg)
+    : m_enabled(cfg.getValue("trackerEnabled", 1) != 0)
+    , m_iouThreshold(cfg.getValue("trackerIouThreshold", 0.3f))
+    , m_maxMissed(cfg.getValue("trackerMaxMissed", 2u))
+    , m_reverifyInterval(cfg.getValue("trackerReverifyInterval", 30.0))
+    , m_lostTimeout(cfg.getValue("trackerLostTimeout", 300.0))
+{
+}
+
+bool ObjectTracker::needsDetection(const std::vector<DetectionBox>& movementBoxes, const Clock::time_point& now)
+{
+    if (!m_enabled || movementBoxes.empty()) {
+        return true;
+    }
+
+    const std::lock_guard<std::mutex> lg(m_mutex);
+    std::vector<bool> explaining(m_tracks.size(), false);
+    for (const DetectionBox& movementBox : movementBoxes) {
+        bool explained = false;
+        for (size_t t = 0; t < m_tracks.size(); ++t) {
+            if (explains(m_tracks[t].predict(now), movementBox)) {
+                explaining[t] = true;
+                explained = true;
+            }
+        }
+        if (!explained) {
+            return true; // something new
+        }
+    }
+
+    for (size_t t = 0; t < m_tracks.size(); ++t) {
+        if (explaining[t] && seconds(m_tracks[t].lastVerified, now) > m_reverifyInterval) {
+            return true;
+        }
+    }
+
+    for (size_t t = 0; t < m_tracks.size(); ++t) {
+        if (explaining[t]) {
+            m_tracks[t].lastMovement = now;
+        }
+    }
+    ++m_skippedDetections;
+    return false;
+}
+
+ObjectTracker::Changes ObjectTracker::update(const std::vector<DetectionResult>& detections, const std::vector<DetectionBox>& inspected, const Clock::time_point& now)
+{
+    Changes changes;
+    const std::lock_guard<std::mutex> lg(m_mutex);
+
+    // greedy matching - the best IoU pairs first
+    struct Candidate {
+        float score;
+        size_t track;
+        size_t detection;
+    };
+    std::vector<Candidate> candidates;
+    for (size_t t = 0; t < m_tracks.size(); ++t) {
+        DetectionBox predicted = m_tracks[t].predict(now);
+        for (size_t d = 0; d < detections.size(); ++d) {
+            if (detections[d].classId == m_tracks[t].classId && matches(predicted, detections[d].box)) {
+                candidates.push_back({BoxUtils::iou(predicted, detections[d].box), t, d});
+            }
+        }
+    }
+    std::sort(candidates.begin(), candidates.end(), [] (const Candidate& a, const Candidate& b) { return a.score > b.score; });
+
+    std::vector<bool> trackMatched(m_tracks.size(), false);
+    std::vector<bool> detectionMatched(detections.size(), false);
+    for (const Candidate& c : candidates) {
+        if (trackMatched[c.track] || detectionMatched[c.detection]) {
+            continue;
+        }
+        trackMatched[c.track] = true;
+        detectionMatched[c.detection] = true;
+
+        Track& track = m_tracks[c.track];
+        const DetectionResult& dr = detections[c.detection];
+        float dt = static_cast<float>(seconds(track.lastVerified, now));
+        if (dt > 0.0f) {
+            track.vx += ((dr.box.x - track.box.x) / dt - track.vx) * VELOCITY_SMOOTHING;
+            track.vy += ((dr.box.y - track.box.y) / dt - track.vy) * VELOCITY_SMOOTHING;
+        }
+        track.box = dr.box;
+        track.probability = dr.probablity;
+        track.missed = 0;
+        track.lastVerified = now;
+        track.lastMovement = now;
+        changes.keptTracks.push_back(track);
+    }
+
+    std::vector<Track> tracks;
+    tracks.reserve(m_tracks.size() + detections.size());
+    for (size_t t = 0; t < m_tracks.size(); ++t) {
+        Track& track = m_tracks[t];
+        if (!trackMatched[t] && isInspected(track.predict(now), inspected)) {
+            // e.g. stationary object away from crops around movement wasn't looked for
+            ++track.missed;
+        }
+        bool timeout = seconds(std::max(track.lastVerified, track.lastMovement), now) > m_lostTimeout;
+        if (track.missed > m_maxMissed || timeout) {
+            changes.lostTracks.push_back(track);
+        }
+        else {
+            tracks.push_back(track);
+        }
+    }
+
+    for (size_t d = 0; d < detections.size(); ++d) {
+        if (detectionMatched[d]) {
+            continue;
+        }
+        const DetectionResult& dr = detections[d];
+        Track track;
+        track.id = m_nextId++;
+        track.classId = dr.classId;
+        track.label = dr.label;
+        track.probability = dr.probablity;
+        track.box = dr.box;
+        track.lastVerified = now;
+        track.lastMovement = now;
+        tracks.push_back(track);
+        changes.newTracks.push_back(track);
+    }
+
+    m_tracks.swap(tracks);
+    return changes;
+}
+
+std::vector<ObjectTracker::Track> ObjectTracker::tracks() const
+{
+    const std::lock_guard<std::mutex> lg(m_mutex);
+    return m_tracks;
+}
+
+uint64_t ObjectTracker::skippedDetections() const
+{
+    const std::lock_guard<std::mutex> lg(m_mutex);
+    return m_skippedDetections;
+}
+
+bool ObjectTracker::explains(const DetectionBox& predicted, const DetectionBox& movementBox) const
+{
+    // movement region covers moving part only (e.g. hand) or the whole object with its previous place,
+    // so overlap is measured against smaller box
+    float overlap = BoxUtils::intersection(predicted, movementBox);
+    float smaller = std::min(BoxUtils::area(predicted), BoxUtils::area(movementBox));
+    return smaller > 0.0f && overlap / smaller >= m_iouThreshold;
+}
+
+bool ObjectTracker::matches(const DetectionBox& predicted, const DetectionBox& detected) const
+{
+    if (BoxUtils::iou(predicted, detected) >= m_iouThreshold) {
+        return true;
+    }
+    // fast or small objects - centroid not further than object size
+    float dx = predicted.x - detected.x;
+    float dy = predicted.y - detected.y;
+    float size = std::max(predicted.w, predicted.h);
+    return std::sqrt(dx*dx + dy*dy) <= size;
+}
+
+bool ObjectTracker::isInspected(const DetectionBox& predicted, const std::vector<DetectionBox>& inspected)
+{
+    return std::any_of(inspected.begin(), inspected.end(), [&predicted] (const DetectionBox& region) {
+        return BoxUtils::intersection(predicted, region) > 0.0f;
+    });
+}
@@ -0,0 +1,98 @@
+//
+// The MIT License (MIT)
+//
+// Copyright 2020 Karolpg
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), 
+// to deal in the Software without restriction, including without limitation the rights to #use, copy, modify, merge, publish, distribute, sublicense, 
+// and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR #COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, 
+// WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include <mutex>
+#include <chrono>
+#include <cstdint>
+#include "Config.h"
+#include "BoxUtils.h"
+#include "Detector.h"
+
+///
+/// \brief The ObjectTracker class - keeps objects found by detector between detections.
+///                                  Movement which is explained by already tracked objects doesn't need detection,
+///                                  so detector is run for new objects (or rarely to verify old ones), not for every movement.
+///                                  Objects are matched by IoU of predicted box, with centroid distance as fallback.
+///
+class ObjectTracker
+{
+public:
+    using Clock = std::chrono::steady_clock;
+
+    struct Track {
+        uint32_t id = 0;
+        uint32_t classId = 0;
+        std::string label;
+        float probability = 0.0f;
+        DetectionBox box = {0.0f, 0.0f, 0.0f, 0.0f}; // from last detection, relative
+        float vx = 0.0f; // [relative/s] box center velocity
+        float vy = 0.0f;
+        uint32_t missed = 0; // detections in a row which didn't find it
+        Clock::time_point lastVerified; // last detection which found it
+        Clock::time_point lastMovement; // last movement explained by it
+
+        DetectionBox predict(const Clock::time_point& time) const;
+    };
+
+    struct Changes {
+        std::vector<Track> newTracks;
+        std::vector<Track> lostTracks;
+        std::vector<Track> keptTracks;
+    };
+
+    ObjectTracker(const Config& cfg);
+
+    bool isEnabled() const { return m_enabled; }
+
+    ///
+    /// \brief needsDetection - checks if movement can be explained by tracked objects
+    /// \param movementBoxes - relative boxes of moving regions, empty - unknown
+    /// \return false when every movement box belongs to predicted place of tracked object and none of them needs verification
+    ///
+    bool needsDetection(const std::vector<DetectionBox>& movementBoxes, const Clock::time_point& now);
+
+    ///
+    /// \brief update - matches detector results with tracks
+    /// \param inspected - relative parts of frame detector looked at, unmatched tracks outside them are not counted as missed
+    /// \return tracks created, lost and kept by this detection
+    ///
+    Changes update(const std::vector<DetectionResult>& detections, const std::vector<DetectionBox>& inspected, const Clock::time_point& now);
+
+    std::vector<Track> tracks() const;
+    uint64_t skippedDetections() const;
+
+private:
+    bool explains(const DetectionBox& predicted, const DetectionBox& movementBox) const;
+    bool matches(const DetectionBox& predicted, const DetectionBox& detected) const;
+    static bool isInspected(const DetectionBox& predicted, const std::vector<DetectionBox>& inspected);
+
+    bool m_enabled;
+    float m_iouThreshold;
+    uint32_t m_maxMissed;
+    double m_reverifyInterval; // [s] tracked object is verified by detector at least this often when it moves
+    double m_lostTimeout;      // [s] track without movement and detection is dropped
+
+    static constexpr float VELOCITY_SMOOTHING = 0.5f; // weight of newest velocity
+
+    mutable std::mutex m_mutex;
+    std::vector<Track> m_tracks;
+    uint32_t m_nextId = 1;
+    uint64_t m_skippedDetections = 0;
+};
@@ -0,0 +1,210 @@
+//
+// The MIT License (MIT)
+//
+// Copyright 2020 Karolpg
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), 
+// to deal in the Software without restriction, including without limitation the rights to #use, copy, modify, merge, publish, distribute, sublicense, 
+// and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR #COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, 
+// WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+
+
+#include "Overlay.h"
+#include "Letters.h"
+
+#include <algorithm>
+#include <cstring>
+#include <map>
+#include <memory>
+#include <mutex>
+
+GlyphAtlas::GlyphAtlas(uint32_t height)
+    : m_height(std::max(1u, height))
+{
+    // glyphs of all chars share data of the same letter (e.g. 'a' and 'A', unknown ones)
+    std::map<const Letter*, uint32_t> letterIdx;
+    std::vector<const Letter*> letters;
+    for (uint32_t ch = 0; ch < m_glyphs.size(); ++ch) {
+        const Letter* letter = &getLetterData(static_cast<char>(ch));
+        if (letterIdx.emplace(letter, static_cast<uint32_t>(letters.size())).second) {
+            letters.push_back(letter);
+        }
+    }
+
+    const float scale = static_cast<float>(m_height) / static_cast<float>(getLetterData('W').h);
+    std::vector<uint32_t> widths;
+    std::vector<size_t> maskOffsets;
+    for (const Letter* letter : letters) {
+        widths.push_back(std::max(1u, static_cast<uint32_t>(letter->w * scale + 0.5f)));
+        maskOffsets.push_back(m_masks.size());
+        m_masks.resize(m_masks.size() + widths.back() * m_height, 0);
+    }
+    m_spans.resize(letters.size() * m_height);
+
+    const float step = 1.0f / (scale * SUPERSAMPLING); // letter pixels per sample
+    for (size_t l = 0; l < letters.size(); ++l) {
+        const Letter& letter = *letters[l];
+        const uint32_t w = widths[l];
+        uint8_t* mask = m_masks.data() + maskOffsets[l];
+        for (uint32_t y = 0; y < m_height; ++y) {
+            Span& span = m_spans[l * m_height + y];
+            span.begin = w;
+            for (uint32_t x = 0; x < w; ++x) {
+                uint32_t covered = 0;
+                for (uint32_t sy = 0; sy < SUPERSAMPLING; ++sy) {
+                    uint32_t ly = std::min(static_cast<uint32_t>((y * SUPERSAMPLING + sy + 0.5f) * step), letter.h - 1);
+                    for (uint32_t sx = 0; sx < SUPERSAMPLING; ++sx) {
+                        uint32_t lx = std::min(static_cast<uint32_t>((x * SUPERSAMPLING + sx + 0.5f) * step), letter.w - 1);
+                        covered += letter.data[ly * letter.w + lx] > 0 ? 1 : 0;
+                    }
+                }
+                const uint32_t samples = SUPERSAMPLING * SUPERSAMPLING;
+                uint8_t alpha = static_cast<uint8_t>((covered * 255 + samples / 2) / samples);
+                mask[y * w + x] = alpha;
+                if (alpha > 0) {
+                    span.begin = std::min(span.begin, x);
+                    span.end = x + 1;
+                }
+            }
+            if (span.begin >= span.end) {
+                span = Span();
+            }
+        }
+    }
+
+    for (uint32_t ch = 0; ch < m_glyphs.size(); ++ch) {
+        uint32_t l = letterIdx[&getLetterData(static_cast<char>(ch))];
+        m_glyphs[ch] = Glyph{widths[l], m_masks.data() + maskOffsets[l], m_spans.data() + l * m_height};
+    }
+}
+
+const GlyphAtlas& GlyphAtlas::forHeight(uint32_t height)
+{
+    static std::mutex mutex;
+    static std::map<uint32_t, std::unique_ptr<GlyphAtlas>> atlases; // few sizes are used - never freed
+    const std::lock_guard<std::mutex> lg(mutex);
+    std::unique_ptr<GlyphAtlas>& atlas = atlases[std::max(1u, height)];
+    if (!atlas) {
+        atlas = std::make_unique<GlyphAtlas>(height);
+    }
+    return *atlas;
+}
+
+uint32_t GlyphAtlas::textWidth(const std::string& text) const
+{
+    uint32_t width = 0;
+    for (char ch : text) {
+        width += glyph(ch).w;
+    }
+    return width;
+}
+
+namespace Overlay {
+
+namespace {
+
+std::array<uint8_t, 4> components(uint32_t colorRgba)
+{
+    return {static_cast<uint8_t>(colorRgba), static_cast<uint8_t>(colorRgba >> 8),
+            static_cast<uint8_t>(colorRgba >> 16), static_cast<uint8_t>(colorRgba >> 24)};
+}
+
+} // namespace
+
+void fillRect(const Canvas& canvas, int left, int top, int right, int bottom, uint32_t colorRgba)
+{
+    const uint32_t x0 = static_cast<uint32_t>(std::clamp(left, 0, static_cast<int>(canvas.w)));
+    const uint32_t x1 = static_cast<uint32_t>(std::clamp(right, 0, static_cast<int>(canvas.w)));
+    const uint32_t y0 = static_cast<uint32_t>(std::clamp(top, 0, static_cast<int>(canvas.h)));
+    const uint32_t y1 = static_cast<uint32_t>(std::clamp(bottom, 0, static_cast<int>(canvas.h)));
+    if (x0 >= x1 || y0 >= y1) {
+        return;
+    }
+
+    const size_t stride = static_cast<size_t>(canvas.w) * canvas.c;
+    const size_t spanBytes = static_cast<size_t>(x1 - x0) * canvas.c;
+    uint8_t* first = canvas.data + y0 * stride + static_cast<size_t>(x0) * canvas.c;
+    const std::array<uint8_t, 4> color = components(colorRgba);
+    for (uint32_t k = 0; k < canvas.c; ++k) {
+        first[k] = color[k % color.size()];
+    }
+    // pixel pattern doubled until row span is filled
+    for (size_t filled = canvas.c; filled < spanBytes; filled *= 2) {
+        std::memcpy(first + filled, first, std::min(filled, spanBytes - filled));
+    }
+    for (uint32_t y = y0 + 1; y < y1; ++y) {
+        std::memcpy(canvas.data + y * stride + static_cast<size_t>(x0) * canvas.c, first, spanBytes);
+    }
+}
+
+void drawBox(const Canvas& canvas, int left, int top, int right, int bottom, uint32_t thickness, uint32_t colorRgba)
+{
+    const int before = static_cast<int>(thickness / 2); // border part outside of edge
+    const int after = static_cast<int>(thickness) - before;
+    fillRect(canvas, left - before, top - before, right + after, top + after, colorRgba);
+    fillRect(canvas, left - before, bottom - before, right + after, bottom + after, colorRgba);
+    fillRect(canvas, left - before, top + after, left + after, bottom - before, colorRgba);
+    fillRect(canvas, right - before, top + after, right + after, bottom - before, colorRgba);
+}
+
+void drawText(const Canvas& canvas, int left, int top, const std::string& text, uint32_t height, uint32_t colorRgba, bool fit)
+{
+    if (left >= static_cast<int>(canvas.w) || top >= static_cast<int>(canvas.h) || text.empty()) {
+        return;
+    }
+    const GlyphAtlas* atlas = &GlyphAtlas::forHeight(height);
+    if (fit) {
+        const uint32_t restW = static_cast<uint32_t>(static_cast<int>(canvas.w) - std::max(left, 0));
+        const uint32_t textW = atlas->textWidth(text);
+        if (textW > restW) {
+            // width of glyphs is proportional to height
+            atlas = &GlyphAtlas::forHeight(static_cast<uint32_t>(static_cast<uint64_t>(height) * restW / textW));
+        }
+    }
+
+    const std::array<uint8_t, 4> color = components(colorRgba);
+    const size_t stride = static_cast<size_t>(canvas.w) * canvas.c;
+    const int rowBegin = std::max(0, -top);
+    const int rowEnd = std::min(static_cast<int>(atlas->height()), static_cast<int>(canvas.h) - top);
+
+    int glyphLeft = left;
+    for (char ch : text) {
+        const GlyphAtlas::Glyph& glyph = atlas->glyph(ch);
+        if (glyphLeft >= static_cast<int>(canvas.w)) {
+            break;
+        }
+        for (int y = rowBegin; y < rowEnd; ++y) {
+            const GlyphAtlas::Span& span = glyph.spans[y];
+            const int xBegin = std::max(static_cast<int>(span.begin), -glyphLeft);
+            const int xEnd = std::min(static_cast<int>(span.end), static_cast<int>(canvas.w) - glyphLeft);
+            const uint8_t* alphaRow = glyph.mask + static_cast<size_t>(y) * glyph.w;
+            uint8_t* row = canvas.data + static_cast<size_t>(top + y) * stride;
+            for (int x = xBegin; x < xEnd; ++x) {
+                const uint32_t alpha = alphaRow[x];
+                if (alpha == 0) {
+                    continue;
+                }
+                uint8_t* pixel = row + static_cast<size_t>(glyphLeft + x) * canvas.c;
+                if (alpha == 255) {
+                    for (uint32_t k = 0; k < canvas.c; ++k) {
+                        pixel[k] = color[k % color.size()];
+                    }
+                }
+                else {
+                    for (uint32_t k = 0; k < canvas.c; ++k) {
+                        pixel[k] = static_cast<uint8_t>((color[k % color.size()] * alpha + pixel[k] * (255 - alpha) + 127) / 255);
+                    }
+                }
+            }
+        }
+        glyphLeft += static_cast<int>(glyph.w);
+    }
+}
+
+} // namespace Overlay
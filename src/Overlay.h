@@ -0,0 +1,93 @@
+//
+// The MIT License (MIT)
+//
+// Copyright 2020 Karolpg
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), 
+// to deal in the Software without restriction, including without limitation the rights to #use, copy, modify, merge, publish, distribute, sublicense, 
+// and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR #COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, 
+// WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+
+
+#pragma once
+
+#include <array>
+#include <string>
+#include <vector>
+#include <cstdint>
+
+///
+/// \brief The GlyphAtlas class - letters of Letters.h scaled once to given pixel height.
+///                              Every glyph is alpha mask (coverage of scaled letter pixel, 0 - 255)
+///                              with span of not empty pixels per row, so drawing doesn't touch empty ones.
+///
+class GlyphAtlas
+{
+public:
+    struct Span {
+        uint32_t begin = 0;
+        uint32_t end = 0;
+    };
+
+    struct Glyph {
+        uint32_t w = 0;
+        const uint8_t* mask = nullptr; // w x height
+        const Span* spans = nullptr;   // per row
+    };
+
+    explicit GlyphAtlas(uint32_t height);
+    GlyphAtlas(const GlyphAtlas&) = delete;
+    GlyphAtlas& operator=(const GlyphAtlas&) = delete;
+
+    ///
+    /// \brief forHeight - shared atlas, built on the first use of the height
+    ///
+    static const GlyphAtlas& forHeight(uint32_t height);
+
+    uint32_t height() const { return m_height; }
+    const Glyph& glyph(char c) const { return m_glyphs[static_cast<uint8_t>(c)]; }
+    uint32_t textWidth(const std::string& text) const;
+
+private:
+    static constexpr uint32_t SUPERSAMPLING = 4; // per axis, for coverage of scaled pixel
+
+    uint32_t m_height;
+    std::array<Glyph, 256> m_glyphs;
+    std::vector<uint8_t> m_masks;
+    std::vector<Span> m_spans;
+};
+
+///
+/// Drawing of annotations directly into interleaved image (e.g. RGBRGB), color is RGBA - R in the lowest byte,
+/// the first c bytes of it are used. Everything is clipped to the image.
+///
+namespace Overlay {
+
+struct Canvas {
+    uint8_t* data;
+    uint32_t w, h, c;
+};
+
+///
+/// \brief fillRect - fills [left, right) x [top, bottom), the first row is filled and copied to others
+///
+void fillRect(const Canvas& canvas, int left, int top, int right, int bottom, uint32_t colorRgba);
+
+///
+/// \brief drawBox - border of thickness centered on box edges
+///
+void drawBox(const Canvas& canvas, int left, int top, int right, int bottom, uint32_t thickness, uint32_t colorRgba);
+
+///
+/// \brief drawText - glyphs of atlas blended by their alpha, once per pixel for all components
+/// \param fit - text is drawn with smaller atlas when it doesn't fit to the right image border
+///
+void drawText(const Canvas& canvas, int left, int top, const std::string& text, uint32_t height, uint32_t colorRgba, bool fit = true);
+
+} // namespace Overlay
@@ -0,0 +1,141 @@
+//
+// The MIT License (MIT)
+//
+// Copyright 2020 Karolpg
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), 
+// to deal in the Software without restriction, including without limitation the rights to #use, copy, modify, merge, publish, distribute, sublicense, 
+// and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR #COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, 
+// WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+
+
+#include "ResultCache.h"
+
+#include <algorithm>
+
+namespace {
+
+double seconds(const ResultCache::Clock::time_point& from, const ResultCache::Clock::time_point& to)
+{
+    std::chrono::duration<double> d = to - from;
+    return d.count();
+}
+
+} // namespace
+
+ResultCache::ResultCache(const Config& cfg)
+    : m_enabled(cfg.getValue("resultCacheEnabled", 1) != 0)
+    , m_ttl(cfg.getValue("resultCacheTtl", 10.0))
+    , m_minIou(cfg.getValue("resultCacheMinIou", 0.8f))
+    , m_maxDistance(cfg.getValue("resultCacheMaxDistance", 4u))
+    , m_maxEntries(std::max(1u, cfg.getValue("resultCacheEntries", 8u)))
+{
+}
+
+ResultCache::Key ResultCache::makeKey(const FrameU8& frame, const FrameDescr& descr, const std::vector<DetectionBox>& regions)
+{
+    Key key;
+    key.regions = regions;
+    if (key.regions.empty()) {
+        key.regions.push_back({0.5f, 0.5f, 1.0f, 1.0f});
+    }
+
+    // dHash - gray of region downscaled to 9x8, bit per horizontal neighbours comparison
+    const uint32_t c = descr.components;
+    for (const DetectionBox& region : key.regions) {
+        const float left = std::clamp(BoxUtils::left(region), 0.0f, 1.0f) * descr.width;
+        const float top = std::clamp(BoxUtils::top(region), 0.0f, 1.0f) * descr.height;
+        const float cellW = (std::clamp(BoxUtils::right(region), 0.0f, 1.0f) * descr.width - left) / HASH_W;
+        const float cellH = (std::clamp(BoxUtils::bottom(region), 0.0f, 1.0f) * descr.height - top) / HASH_H;
+
+        uint32_t gray[HASH_H][HASH_W];
+        for (uint32_t cy = 0; cy < HASH_H; ++cy) {
+            for (uint32_t cx = 0; cx < HASH_W; ++cx) {
+                uint32_t sum = 0;
+                for (uint32_t sy = 0; sy < SAMPLES; ++sy) {
+                    uint32_t y = std::min(static_cast<uint32_t>(top + (cy + (sy + 0.5f) / SAMPLES) * cellH), descr.height - 1);
+                    for (uint32_t sx = 0; sx < SAMPLES; ++sx) {
+                        uint32_t x = std::min(static_cast<uint32_t>(left + (cx + (sx + 0.5f) / SAMPLES) * cellW), descr.width - 1);
+                        const uint8_t* pixel = &frame.data[(static_cast<size_t>(y) * descr.width + x) * c];
+                        for (uint32_t k = 0; k < std::min(c, 3u); ++k) {
+                            sum += pixel[k];
+                        }
+                    }
+                }
+                gray[cy][cx] = sum;
+            }
+        }
+
+        uint64_t hash = 0;
+        for (uint32_t cy = 0; cy < HASH_H; ++cy) {
+            for (uint32_t cx = 0; cx + 1 < HASH_W; ++cx) {
+                hash = (hash << 1) | (gray[cy][cx] < gray[cy][cx + 1] ? 1u : 0u);
+            }
+        }
+        key.hashes.push_back(hash);
+    }
+    return key;
+}
+
+bool ResultCache::matches(const Entry& entry, const Key& key) const
+{
+    for (size_t r = 0; r < key.regions.size(); ++r) {
+        bool matched = false;
+        for (size_t e = 0; e < entry.key.regions.size() && !matched; ++e) {
+            matched = static_cast<uint32_t>(__builtin_popcountll(key.hashes[r] ^ entry.key.hashes[e])) <= m_maxDistance
+                   && BoxUtils::iou(key.regions[r], entry.key.regions[e]) >= m_minIou;
+        }
+        if (!matched) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool ResultCache::find(const void* source, const Key& key, const Clock::time_point& now, std::vector<Result>& results)
+{
+    const std::lock_guard<std::mutex> lg(m_mutex);
+    ++m_metrics.lookups;
+    for (const Entry& entry : m_entries) {
+        if (entry.source == source && seconds(entry.time, now) <= m_ttl && matches(entry, key)) {
+            results = entry.results;
+            ++m_metrics.hits;
+            return true;
+        }
+    }
+    return false;
+}
+
+void ResultCache::store(const void* source, Key&& key, const Clock::time_point& now, std::vector<Result>&& results)
+{
+    const std::lock_guard<std::mutex> lg(m_mutex);
+    // expired ones and the oldest of source over limit
+    uint32_t sourceEntries = 0;
+    auto kept = std::remove_if(m_entries.begin(), m_entries.end(), [&] (const Entry& entry) {
+        if (seconds(entry.time, now) > m_ttl) {
+            return true;
+        }
+        return entry.source == source && ++sourceEntries >= m_maxEntries;
+    });
+    m_entries.erase(kept, m_entries.end());
+    m_entries.push_front(Entry{source, std::move(key), now, std::move(results)});
+}
+
+void ResultCache::removeSource(const void* source)
+{
+    const std::lock_guard<std::mutex> lg(m_mutex);
+    m_entries.erase(std::remove_if(m_entries.begin(), m_entries.end(), [source] (const Entry& entry) { return entry.source == source; }),
+                    m_entries.end());
+}
+
+ResultCache::Metrics ResultCache::getMetrics() const
+{
+    const std::lock_guard<std::mutex> lg(m_mutex);
+    return m_metrics;
+}
@@ -0,0 +1,99 @@
+//
+// The MIT License (MIT)
+//
+// Copyright 2020 Karolpg
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), 
+// to deal in the Software without restriction, including without limitation the rights to #use, copy, modify, merge, publish, distribute, sublicense, 
+// and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR #COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, 
+// WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+
+
+#pragma once
+
+#include <vector>
+#include <deque>
+#include <mutex>
+#include <chrono>
+#include <cstdint>
+#include "Config.h"
+#include "Frame.h"
+#include "BoxUtils.h"
+
+///
+/// \brief The ResultCache class - recent detection results per source (camera), keyed by motion regions and
+///                                perceptual hash (dHash) of their content. Trigger whose every region matches region
+///                                of recent result (similar place and look) reuses that result instead of inference,
+///                                e.g. flag in the wind or trees keep moving but nothing new appears.
+///                                Results live "resultCacheTtl" seconds from inference, reuse doesn't extend it.
+///
+class ResultCache
+{
+public:
+    using Clock = std::chrono::steady_clock;
+
+    // label is taken from detector which reuses result - cache outlives labels of the detector which stored it
+    struct Result {
+        uint32_t classId;
+        float probability;
+        DetectionBox box;
+    };
+
+    struct Key {
+        std::vector<DetectionBox> regions; // whole frame when trigger has no regions
+        std::vector<uint64_t> hashes;      // per region
+    };
+
+    struct Metrics {
+        uint64_t lookups = 0;
+        uint64_t hits = 0;
+        double hitRate() const { return lookups > 0 ? static_cast<double>(hits) / static_cast<double>(lookups) : 0.0; }
+    };
+
+    ResultCache(const Config& cfg);
+
+    bool isEnabled() const { return m_enabled; }
+
+    static Key makeKey(const FrameU8& frame, const FrameDescr& descr, const std::vector<DetectionBox>& regions);
+
+    ///
+    /// \return true and results of matching entry, false when there is no fresh entry matching every region of key
+    ///
+    bool find(const void* source, const Key& key, const Clock::time_point& now, std::vector<Result>& results);
+
+    void store(const void* source, Key&& key, const Clock::time_point& now, std::vector<Result>&& results);
+
+    void removeSource(const void* source);
+
+    Metrics getMetrics() const;
+
+private:
+    struct Entry {
+        const void* source;
+        Key key;
+        Clock::time_point time;
+        std::vector<Result> results;
+    };
+
+    bool matches(const Entry& entry, const Key& key) const;
+
+    bool m_enabled;
+    double m_ttl;            // [s]
+    float m_minIou;          // of trigger region and cached one
+    uint32_t m_maxDistance;  // of hashes [bits of 64]
+    uint32_t m_maxEntries;   // per source
+
+    mutable std::mutex m_mutex;
+    std::deque<Entry> m_entries; // the newest first
+    Metrics m_metrics;
+
+    static constexpr uint32_t HASH_W = 9; // gradients of 8 neighbours in row
+    static constexpr uint32_t HASH_H = 8;
+    static constexpr uint32_t SAMPLES = 4; // per axis in hash cell - big regions aren't averaged pixel by pixel
+};
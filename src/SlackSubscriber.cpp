@@ -118,6 +118,21 @@ void SlackSubscriber::onCurrentFrameReady(const FrameU8 &f, const FrameDescr &fd
     localThis->m_slackThread.addJob(std::chrono::microseconds(0), frameReadyJob);
 }
 
+void SlackSubscriber::onHeatmapFrameReady(const FrameU8 &f, const FrameDescr &fd, void *ctx)
+{
+    SlackSubscriber* localThis = reinterpret_cast<SlackSubscriber*>(ctx);
+    assert(localThis);
+
+    {
+        std::unique_ptr<FrameData> frameData = std::unique_ptr<FrameData>(new FrameData{f, fd});
+        std::lock_guard<std::mutex> lg(localThis->m_heatmapFrameQueueMtx);
+        localThis->m_heatmapFrameQueue.push(std::move(frameData));
+    }
+
+    std::shared_ptr<Job> heatmapJob = std::shared_ptr<Job>(new SimpleJob( [localThis]() { localThis->sendHeatmap(); } ));
+    localThis->m_slackThread.addJob(std::chrono::microseconds(0), heatmapJob);
+}
+
 void SlackSubscriber::onDetect(const FrameU8 &f, const FrameDescr &fd, const std::string &detectionInfo, void *ctx)
 {
     SlackSubscriber* localThis = reinterpret_cast<SlackSubscriber*>(ctx);
@@ -191,6 +206,50 @@ void SlackSubscriber::sendFrame()
     }
 }
 
+void SlackSubscriber::sendHeatmap()
+{
+    std::cout << "sendHeatmap\n";
+    std::cout.flush();
+
+    std::unique_ptr<FrameData> frameData;
+    {
+        std::lock_guard<std::mutex> lg(m_heatmapFrameQueueMtx);
+        if (m_heatmapFrameQueue.empty()) {
+            std::cerr << "Fake invoke. There is no frame for heatmap!\n";
+            return;
+        }
+        frameData.swap(m_heatmapFrameQueue.front());
+        m_heatmapFrameQueue.pop();
+    }
+    if (!m_frameControler) {
+        return;
+    }
+
+    const MotionHeatmap& heatmap = m_frameControler->getMotionHeatmap();
+    std::vector<uint8_t> overlay;
+    if (!heatmap.isEnabled() || !heatmap.renderOverlay(frameData->f, frameData->fd, overlay)) {
+        for (size_t c = 0; c < m_notifyChannels.size(); ++c) {
+            m_slack->sendMessage(m_notifyChannels[c].name, heatmap.isEnabled() ? u8"There is no movement in heatmap yet" : u8"Heatmap is disabled");
+        }
+        return;
+    }
+
+    const uint32_t components = 3;
+    uint32_t rawSize = frameData->fd.width * frameData->fd.height * components;
+    m_memoryPngFile.resize(PngTools::PNG_HEADER_SIZE + rawSize, '\0');
+    FILE* fd = fmemopen(m_memoryPngFile.data(), m_memoryPngFile.size(), "wb");
+    if (PngTools::writePngFile(fd, frameData->fd.width, frameData->fd.height, components, overlay.data())) {
+        size_t fileSize = static_cast<size_t>(ftell(fd));
+        fclose(fd);
+        std::string frameName = std::string(u8"heatmap_") + std::to_string(frameData->f.nr) + u8".png";
+        m_slack->sendFile(m_notifyChannels, m_memoryPngFile.data(), fileSize, frameName, SlackFileType::png);
+    }
+    else  {
+        std::cerr << "Can't prepare png in memory!\n";
+        fclose(fd);
+    }
+}
+
 void SlackSubscriber::sendDetectionData()
 {
     std::cout << "sendDetectionData\n";
@@ -290,6 +349,8 @@ void SlackSubscriber::checkIncomingMessage()
                     "Camera monitoring supports:\n"
                     "  #help \n"
                     "  #giveFrame \n"
+                    "  #giveHeatmap \n"
+                    "  #giveStats \n"
                     "  #delete {last [n], yyyy.mm.dd, all} \n"
                     "  #listVideo [all]\n"
                     "  #giveVideo {last, nr n, filename}";
@@ -300,6 +361,17 @@ void SlackSubscriber::checkIncomingMessage()
                 m_frameControler->subscribeOnCurrentFrame(onCurrentFrameReady, this);
             }
         }
+        else if (StringUtils::starts_with(text, TEXT_AND_SIZE("#giveHeatmap"))) {
+            if (m_frameControler) {
+                m_frameControler->subscribeOnCurrentFrame(onHeatmapFrameReady, this);
+            }
+        }
+        else if (StringUtils::starts_with(text, TEXT_AND_SIZE("#giveStats"))) {
+            std::shared_ptr<DetectorPool> detectorPool = m_frameControler ? m_frameControler->getDetectorPool() : nullptr;
+            if (detectorPool) {
+                m_slack->sendMessage(m_notifyChannels[c].name, "Detection stats:\n" + detectorPool->getStats().toString());
+            }
+        }
         else if (StringUtils::starts_with(text, TEXT_AND_SIZE("#delete"))) {
             if (m_deleteRequest) {
                 m_slack->sendMessage(m_notifyChannels[c].name, "Currently processing another delete request!");
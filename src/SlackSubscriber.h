@@ -64,6 +64,7 @@ private:
 
 private:
     static void onCurrentFrameReady(const FrameU8& f, const FrameDescr& fd, void* ctx);
+    static void onHeatmapFrameReady(const FrameU8& f, const FrameDescr& fd, void* ctx);
     static void onDetect(const FrameU8& f, const FrameDescr& fd, const std::string& detectionInfo, void* ctx);
     static void onVideoReady(const std::string& filePath, void* ctx);
 
@@ -80,6 +81,10 @@ private:
     std::mutex m_currentFrameQueueMtx;
     void sendFrame();
 
+    std::queue<std::unique_ptr<FrameData>> m_heatmapFrameQueue; // background frames for heatmap
+    std::mutex m_heatmapFrameQueueMtx;
+    void sendHeatmap();
+
 
     struct DetectionData {
         FrameData frameData;
@@ -0,0 +1,76 @@
+//
+// The MIT License (MIT)
+//
+// Copyright 2020 Karolpg
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), 
+// to deal in the Software without restriction, including without limitation the rights to #use, copy, modify, merge, publish, distribute, sublicense, 
+// and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR #COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, 
+// WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+
+#include "SyntheticBackend.h"
+
+#include <iostream>
+#include <sstream>
+#include <thread>
+#include <chrono>
+#include <algorithm>
+
+SyntheticBackend::SyntheticBackend(const Config& cfg)
+    : m_width(std::max(1u, cfg.getValue("syntheticWidth", 416u)))
+    , m_height(std::max(1u, cfg.getValue("syntheticHeight", 416u)))
+    , m_channels(std::max(1u, cfg.getValue("syntheticChannels", 3u)))
+    , m_classes(std::max(1u, cfg.getValue("syntheticClasses", 80u)))
+    , m_batchLatency(cfg.getValue("syntheticLatency", 0.05))
+    , m_inputLatency(cfg.getValue("syntheticInputLatency", 0.0))
+    , m_everyNth(std::max(1u, cfg.getValue("syntheticEveryNth", 1u)))
+{
+    // "classId x y w h probability; ..." - box relative to network input
+    std::istringstream script(cfg.getValue("syntheticBoxes"));
+    std::string entry;
+    while (std::getline(script, entry, ';')) {
+        if (entry.find_first_not_of(' ') == std::string::npos) {
+            continue;
+        }
+        std::istringstream values(entry);
+        ScriptedBox sb;
+        if (!(values >> sb.classId >> sb.box.x >> sb.box.y >> sb.box.w >> sb.box.h >> sb.probability) || sb.classId >= m_classes) {
+            std::cout << "[WARNING] Invalid synthetic box: " << entry << "\n";
+            continue;
+        }
+        m_boxes.push_back(sb);
+    }
+    std::cout << "Synthetic detector backend: " << m_width << "x" << m_height << "x" << m_channels << ", " << m_boxes.size() << " scripted boxes\n";
+}
+
+void SyntheticBackend::predict(const float* inputs, uint32_t count)
+{
+    (void)inputs;
+    m_predictedInputs += m_lastCount;
+    m_lastCount = count;
+    std::this_thread::sleep_for(std::chrono::duration<double>(m_batchLatency + m_inputLatency * count));
+}
+
+void SyntheticBackend::detections(uint32_t batchIdx, float threshold, float nmsIou, Detections& out)
+{
+    (void)nmsIou; // scripted boxes are meant to be returned as they are
+    out.boxes.clear();
+    out.probabilities.clear();
+    if ((m_predictedInputs + batchIdx) % m_everyNth != 0) {
+        return;
+    }
+    for (const ScriptedBox& sb : m_boxes) {
+        if (sb.probability <= threshold) {
+            continue;
+        }
+        out.boxes.push_back(sb.box);
+        out.probabilities.resize(out.probabilities.size() + m_classes, 0.0f);
+        out.probabilities[out.probabilities.size() - m_classes + sb.classId] = sb.probability;
+    }
+}
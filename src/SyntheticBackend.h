@@ -0,0 +1,56 @@
+//
+// The MIT License (MIT)
+//
+// Copyright 2020 Karolpg
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), 
+// to deal in the Software without restriction, including without limitation the rights to #use, copy, modify, merge, publish, distribute, sublicense, 
+// and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR #COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, 
+// WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+
+#pragma once
+
+#include "InferenceBackend.h"
+
+///
+/// \brief The SyntheticBackend class - deterministic stand-in for network. predict() sleeps for configured latency
+///                                     (CPU stays free for the rest of pipeline) and every n-th input gets scripted boxes.
+///
+class SyntheticBackend : public InferenceBackend
+{
+public:
+    SyntheticBackend(const Config& cfg);
+
+    uint32_t width() const override { return m_width; }
+    uint32_t height() const override { return m_height; }
+    uint32_t channels() const override { return m_channels; }
+    uint32_t classes() const override { return m_classes; }
+
+    void predict(const float* inputs, uint32_t count) override;
+    void detections(uint32_t batchIdx, float threshold, float nmsIou, Detections& out) override;
+
+private:
+    struct ScriptedBox {
+        uint32_t classId;
+        DetectionBox box;
+        float probability;
+    };
+
+    uint32_t m_width;
+    uint32_t m_height;
+    uint32_t m_channels;
+    uint32_t m_classes;
+    double m_batchLatency; // [s] per predict()
+    double m_inputLatency; // [s] per input
+    uint32_t m_everyNth;   // inputs with boxes
+    std::vector<ScriptedBox> m_boxes;
+
+    uint64_t m_predictedInputs = 0; // before last predict()
+    uint32_t m_lastCount = 0;       // inputs of last predict()
+};
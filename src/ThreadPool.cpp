@@ -0,0 +1,119 @@
+//
+// The MIT License (MIT)
+//
+// Copyright 2020 Karolpg
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), 
+// to deal in the Software without restriction, including without limitation the rights to #use, copy, modify, merge, publish, distribute, sublicense, 
+// and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR #COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, 
+// WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+
+
+#include "ThreadPool.h"
+#include <algorithm>
+#include <assert.h>
+
+ThreadPool& ThreadPool::shared()
+{
+    static ThreadPool pool(std::max(1u, std::thread::hardware_concurrency()) - 1);
+    return pool;
+}
+
+ThreadPool::ThreadPool(uint32_t threadCount)
+{
+    m_threads.reserve(threadCount);
+    for (uint32_t i = 0; i < threadCount; ++i) {
+        m_threads.emplace_back([this] { workerLoop(); });
+    }
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lg(m_tasksMtx);
+        m_destroy = true;
+    }
+    m_waitForTask.notify_all();
+    for (auto& t : m_threads) {
+        t.join();
+    }
+}
+
+void ThreadPool::parallelFor(uint32_t count, uint32_t maxThreads, const StripFunc& func)
+{
+    if (count == 0) {
+        return;
+    }
+    uint32_t strips = threadCount() + 1;
+    if (maxThreads > 0) {
+        strips = std::min(strips, maxThreads);
+    }
+    strips = std::min(strips, count);
+
+    if (strips == 1) {
+        func(0, count, 0); // nothing to share
+        return;
+    }
+
+    auto task = std::make_shared<Task>();
+    task->func = &func;
+    task->count = count;
+    task->strips = strips;
+    {
+        std::lock_guard<std::mutex> lg(m_tasksMtx);
+        m_tasks.push_back(task);
+    }
+    m_waitForTask.notify_all();
+
+    runStrips(task);
+
+    std::unique_lock<std::mutex> ul(m_tasksMtx);
+    m_waitForDone.wait(ul, [&task] { return task->doneStrips == task->strips; });
+}
+
+void ThreadPool::workerLoop()
+{
+    for (;;) {
+        std::shared_ptr<Task> task;
+        {
+            std::unique_lock<std::mutex> ul(m_tasksMtx);
+            m_waitForTask.wait(ul, [this] { return m_destroy || !m_tasks.empty(); });
+            if (m_destroy) {
+                break;
+            }
+            task = m_tasks.front();
+        }
+        runStrips(task);
+    }
+}
+
+void ThreadPool::runStrips(const std::shared_ptr<Task>& task)
+{
+    for (;;) {
+        uint32_t strip = task->nextStrip++;
+        if (strip >= task->strips) {
+            // every strip is taken - nobody else should look at this task
+            std::lock_guard<std::mutex> lg(m_tasksMtx);
+            auto it = std::find(m_tasks.begin(), m_tasks.end(), task);
+            if (it != m_tasks.end()) {
+                m_tasks.erase(it);
+            }
+            return;
+        }
+
+        uint32_t begin = static_cast<uint32_t>(static_cast<uint64_t>(task->count) * strip / task->strips);
+        uint32_t end = static_cast<uint32_t>(static_cast<uint64_t>(task->count) * (strip + 1) / task->strips);
+        (*task->func)(begin, end, strip);
+
+        if (++task->doneStrips == task->strips) {
+            std::lock_guard<std::mutex> lg(m_tasksMtx); // caller checks predicate under this mutex
+            m_waitForDone.notify_all();
+        }
+    }
+}
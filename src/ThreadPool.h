@@ -0,0 +1,79 @@
+//
+// The MIT License (MIT)
+//
+// Copyright 2020 Karolpg
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), 
+// to deal in the Software without restriction, including without limitation the rights to #use, copy, modify, merge, publish, distribute, sublicense, 
+// and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR #COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, 
+// WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+
+
+#pragma once
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <atomic>
+#include <memory>
+#include <vector>
+#include <deque>
+#include <cstdint>
+
+///
+/// \brief The ThreadPool class - persistent workers shared by whole application.
+///                              Threads are created once, so parallelFor doesn't pay for spawning/joining threads.
+///
+class ThreadPool
+{
+public:
+    using StripFunc = std::function<void(uint32_t begin, uint32_t end, uint32_t strip)>;
+
+    ///
+    /// \brief shared - pool used by image processing, workers count = hardware threads - 1 (caller also works)
+    ///
+    static ThreadPool& shared();
+
+    explicit ThreadPool(uint32_t threadCount);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    uint32_t threadCount() const { return static_cast<uint32_t>(m_threads.size()); }
+
+    ///
+    /// \brief parallelFor - splits range [0, count) into continuous strips and runs func on them.
+    ///                      Calling thread takes strips too and returns when all strips are done.
+    /// \param count      - range size, e.g. rows count
+    /// \param maxThreads - how many threads (including caller) can work on it, 0 means all available
+    /// \param func       - called once per strip with [begin, end) range and strip index
+    ///
+    void parallelFor(uint32_t count, uint32_t maxThreads, const StripFunc& func);
+
+private:
+    struct Task {
+        const StripFunc* func = nullptr;
+        uint32_t count = 0;
+        uint32_t strips = 0;
+        std::atomic<uint32_t> nextStrip{0};
+        std::atomic<uint32_t> doneStrips{0};
+    };
+
+    void workerLoop();
+    void runStrips(const std::shared_ptr<Task>& task);
+
+    std::mutex m_tasksMtx;
+    std::condition_variable m_waitForTask;
+    std::condition_variable m_waitForDone;
+    std::deque<std::shared_ptr<Task>> m_tasks;
+    bool m_destroy = false;
+    std::vector<std::thread> m_threads;
+};
@@ -0,0 +1,107 @@
+//
+// The MIT License (MIT)
+//
+// Copyright 2020 Karolpg
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), 
+// to deal in the Software without restriction, including without limitation the rights to #use, copy, modify, merge, publish, distribute, sublicense, 
+// and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR #COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, 
+// WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+
+#include "TriggerFilter.h"
+
+#include <algorithm>
+#include <bitset>
+
+TriggerFilter::TriggerFilter(const Config& cfg)
+    : m_confirmN(cfg.getValue("motionConfirmN", 3u))
+    , m_confirmM(std::clamp(cfg.getValue("motionConfirmM", 4u), 1u, 32u))
+    , m_minPersistence(cfg.getValue("motionMinPersistence", 3u))
+    , m_persistenceMargin(cfg.getValue("motionPersistenceMargin", 0.05f))
+    , m_zoneCooldown(cfg.getValue("motionZoneCooldown", 3.0))
+    , m_zonesX(std::max(1u, cfg.getValue("motionZonesX", 4u)))
+    , m_zonesY(std::max(1u, cfg.getValue("motionZonesY", 4u)))
+{
+    m_confirmN = std::min(m_confirmN, m_confirmM);
+    m_zoneCooldownEnd.resize(m_zonesX*m_zonesY);
+}
+
+bool TriggerFilter::update(bool active, std::vector<DetectionBox>& boxes, const Clock::time_point& now)
+{
+    // persistence - how many samples in a row region was moving, region continues any close region of previous sample
+    std::vector<uint32_t> persistence(boxes.size(), 1);
+    for (size_t i = 0; i < boxes.size(); ++i) {
+        for (size_t p = 0; p < m_prevBoxes.size(); ++p) {
+            if (BoxUtils::touch(boxes[i], m_prevBoxes[p], m_persistenceMargin, m_persistenceMargin)) {
+                persistence[i] = std::max(persistence[i], m_prevPersistence[p] + 1);
+            }
+        }
+    }
+    m_prevBoxes = boxes;
+    m_prevPersistence = persistence;
+
+    const uint32_t window = m_confirmM < 32 ? (1u << m_confirmM) - 1 : UINT32_MAX;
+    m_history = ((m_history << 1) | (active ? 1u : 0u)) & window;
+
+    if (!active) {
+        boxes.clear();
+        return false;
+    }
+
+    if (std::bitset<32>(m_history).count() < m_confirmN) {
+        ++m_counters.unconfirmed;
+        boxes.clear();
+        return false;
+    }
+
+    std::vector<DetectionBox> persistentBoxes;
+    for (size_t i = 0; i < boxes.size(); ++i) {
+        if (persistence[i] >= m_minPersistence) {
+            persistentBoxes.push_back(boxes[i]);
+        }
+    }
+    if (persistentBoxes.empty()) {
+        ++m_counters.notPersistent;
+        boxes.clear();
+        return false;
+    }
+
+    // zones (cells of grid) covered by box
+    auto forEachZone = [this] (const DetectionBox& box, auto func) {
+        uint32_t zx0 = static_cast<uint32_t>(std::clamp(BoxUtils::left(box), 0.0f, 1.0f) * m_zonesX);
+        uint32_t zx1 = static_cast<uint32_t>(std::clamp(BoxUtils::right(box), 0.0f, 1.0f) * m_zonesX);
+        uint32_t zy0 = static_cast<uint32_t>(std::clamp(BoxUtils::top(box), 0.0f, 1.0f) * m_zonesY);
+        uint32_t zy1 = static_cast<uint32_t>(std::clamp(BoxUtils::bottom(box), 0.0f, 1.0f) * m_zonesY);
+        for (uint32_t zy = zy0; zy <= std::min(zy1, m_zonesY - 1); ++zy) {
+            for (uint32_t zx = zx0; zx <= std::min(zx1, m_zonesX - 1); ++zx) {
+                func(zy*m_zonesX + zx);
+            }
+        }
+    };
+
+    boxes.clear();
+    for (const DetectionBox& box : persistentBoxes) {
+        bool cooling = true;
+        forEachZone(box, [this, &now, &cooling] (uint32_t zone) { cooling = cooling && now < m_zoneCooldownEnd[zone]; });
+        if (!cooling) {
+            boxes.push_back(box);
+        }
+    }
+    if (boxes.empty()) {
+        ++m_counters.cooldown;
+        return false;
+    }
+
+    const auto cooldownEnd = now + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(m_zoneCooldown));
+    for (const DetectionBox& box : boxes) {
+        forEachZone(box, [this, &cooldownEnd] (uint32_t zone) { m_zoneCooldownEnd[zone] = cooldownEnd; });
+    }
+    ++m_counters.triggers;
+    return true;
+}
@@ -0,0 +1,67 @@
+//
+// The MIT License (MIT)
+//
+// Copyright 2020 Karolpg
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), 
+// to deal in the Software without restriction, including without limitation the rights to #use, copy, modify, merge, publish, distribute, sublicense, 
+// and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR #COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, 
+// WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+
+#pragma once
+
+#include <vector>
+#include <chrono>
+#include <cstdint>
+#include "Config.h"
+#include "BoxUtils.h"
+
+///
+/// \brief The TriggerFilter class - debouncing of movement triggers.
+///                                  Movement is reported when it is seen in N of last M samples, its region persists
+///                                  over consecutive samples and its zone is not in cooldown after previous trigger.
+///
+class TriggerFilter
+{
+public:
+    using Clock = std::chrono::steady_clock;
+
+    struct Counters {
+        uint64_t triggers = 0;
+        uint64_t unconfirmed = 0;   // suppressed - not enough active samples of last M
+        uint64_t notPersistent = 0; // suppressed - region didn't persist long enough
+        uint64_t cooldown = 0;      // suppressed - every region is in zone which triggered recently
+    };
+
+    TriggerFilter(const Config& cfg);
+
+    ///
+    /// \param active - sample has big enough moving region
+    /// \param boxes  - in: moving regions of sample, out: regions which trigger
+    /// \return true when movement should be reported
+    ///
+    bool update(bool active, std::vector<DetectionBox>& boxes, const Clock::time_point& now);
+
+    const Counters& counters() const { return m_counters; }
+
+private:
+    uint32_t m_confirmN;
+    uint32_t m_confirmM;
+    uint32_t m_minPersistence; // [samples]
+    float m_persistenceMargin; // relative - region of next sample can be that far from previous one (object moves)
+    double m_zoneCooldown;     // [s]
+    uint32_t m_zonesX;
+    uint32_t m_zonesY;
+
+    uint32_t m_history = 0; // bit per sample, the newest is bit 0
+    std::vector<DetectionBox> m_prevBoxes;
+    std::vector<uint32_t> m_prevPersistence;
+    std::vector<Clock::time_point> m_zoneCooldownEnd;
+    Counters m_counters;
+};
@@ -0,0 +1,268 @@
+//
+// The MIT License (MIT)
+//
+// Copyright 2020 Karolpg
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), 
+// to deal in the Software without restriction, including without limitation the rights to #use, copy, modify, merge, publish, distribute, sublicense, 
+// and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR #COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, 
+// WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+
+//
+// bench_motion - runs MovementAnalyzer synchronously over recorded frames and reports stage times
+//                and trigger precision/recall.
+//
+// Usage: bench_motion <png_dir|video_file> [ground_truth_file] [config_file] [png_fps]
+//
+// Png frames are taken in name order, frame time comes from frame index and png_fps (default 25).
+// Video frame time comes from buffer timestamps. Ground truth file contains ranges of frame numbers
+// (0 based, inclusive) with movement, one event per line: "first last", lines starting with '#' are skipped.
+// Every frame is analyzed against previous one, so frame 0 is only a base.
+// Scoring is per event, as analyzer sends one debounced trigger per event: range hit by at least one trigger
+// is true positive, range without trigger is false negative, trigger outside every range is false positive.
+//
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <functional>
+#include <chrono>
+#include <cstdlib>
+#include <gst/gst.h>
+
+#include "MovementAnalyzer.h"
+#include "Config.h"
+#include "DirUtils.h"
+#include "PngTools.h"
+#include "StringUtils.h"
+
+namespace {
+
+using FrameFunc = std::function<void(const FrameU8& frame, const FrameDescr& descr)>;
+
+struct StageStats {
+    double sum = 0.0;
+    double max = 0.0;
+
+    void add(double value) {
+        sum += value;
+        max = std::max(max, value);
+    }
+};
+
+bool readGroundTruth(const std::string& filePath, std::vector<std::pair<uint64_t, uint64_t>>& ranges)
+{
+    std::ifstream file(filePath);
+    if (!file.is_open()) {
+        std::cerr << "Can't open ground truth file: " << filePath << "\n";
+        return false;
+    }
+    std::string line;
+    while (std::getline(file, line)) {
+        if (line.empty() || line[0] == '#') {
+            continue;
+        }
+        std::istringstream iss(line);
+        uint64_t first, last;
+        if (!(iss >> first >> last) || last < first) {
+            std::cerr << "Invalid ground truth line: " << line << "\n";
+            return false;
+        }
+        ranges.push_back({first, last});
+    }
+    return true;
+}
+
+uint64_t readPngDir(const std::string& dirPath, double fps, const FrameFunc& onFrame)
+{
+    std::vector<std::string> files = DirUtils::listDir(dirPath);
+    files.erase(std::remove_if(files.begin(), files.end(),
+                               [] (const std::string& f) { return !StringUtils::ends_with(f, ".png"); }),
+                files.end());
+    std::sort(files.begin(), files.end());
+
+    const auto startTime = std::chrono::steady_clock::now();
+    uint64_t frameNr = 0;
+    FrameU8 frame;
+    FrameDescr descr;
+    for (const std::string& file : files) {
+        std::string filePath = DirUtils::cleanPath(dirPath + "/" + file);
+        if (!PngTools::readPngFile(filePath.c_str(), descr.width, descr.height, descr.components, frame.data)) {
+            std::cerr << "Can't read png file: " << filePath << "\n";
+            continue;
+        }
+        frame.time = startTime + std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(frameNr / fps));
+        frame.nr = frameNr++;
+        frame.bufferIdx = 0;
+        onFrame(frame, descr);
+    }
+    return frameNr;
+}
+
+uint64_t readVideo(const std::string& filePath, double fps, const FrameFunc& onFrame)
+{
+    gst_init(nullptr, nullptr);
+
+    gchar* uri = gst_filename_to_uri(filePath.c_str(), nullptr);
+    if (!uri) {
+        std::cerr << "Invalid video file path: " << filePath << "\n";
+        return 0;
+    }
+    std::string pipelineCmd = std::string("uridecodebin uri=") + uri
+                              + " ! videoconvert ! video/x-raw,format=RGB ! appsink name=mysink sync=false";
+    g_free(uri);
+
+    GstElement* pipeline = gst_parse_launch(pipelineCmd.c_str(), nullptr);
+    if (!pipeline) {
+        std::cerr << "Can't create pipeline with string: " << pipelineCmd << "\n";
+        return 0;
+    }
+    GstElement* appSink = gst_bin_get_by_name(GST_BIN(pipeline), "mysink");
+    gst_element_set_state(pipeline, GST_STATE_PLAYING);
+
+    const auto startTime = std::chrono::steady_clock::now();
+    uint64_t frameNr = 0;
+    FrameU8 frame;
+    FrameDescr descr;
+    descr.components = 3;
+    while (true) {
+        GstSample *sample = nullptr;
+        g_signal_emit_by_name(appSink, "pull-sample", &sample); // blocks, nullptr on EOS or error
+        if (!sample) {
+            break;
+        }
+        GstStructure *structure = gst_caps_get_structure(gst_sample_get_caps(sample), 0);
+        int w = 0;
+        int h = 0;
+        gst_structure_get_int(structure, "width", &w);
+        gst_structure_get_int(structure, "height", &h);
+        descr.width = w > 0 ? static_cast<uint32_t>(w) : 0;
+        descr.height = h > 0 ? static_cast<uint32_t>(h) : 0;
+
+        GstBuffer *sampleBuffer = gst_sample_get_buffer(sample);
+        GstMapInfo map;
+        if (sampleBuffer && descr.width * descr.height > 0 && gst_buffer_map(sampleBuffer, &map, GST_MAP_READ)) {
+            // rows are 4 bytes aligned in RGB format
+            const uint32_t stride = (descr.width * descr.components + 3) & ~3u;
+            const uint32_t rowSize = descr.width * descr.components;
+            frame.data.resize(rowSize * descr.height);
+            for (uint32_t y = 0; y < descr.height; ++y) {
+                std::copy(map.data + y * stride, map.data + y * stride + rowSize, &frame.data[y * rowSize]);
+            }
+            gst_buffer_unmap(sampleBuffer, &map);
+            const GstClockTime pts = GST_BUFFER_PTS(sampleBuffer);
+            frame.time = GST_CLOCK_TIME_IS_VALID(pts)
+                       ? startTime + std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::nanoseconds(pts))
+                       : startTime + std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(frameNr / fps));
+            frame.nr = frameNr++;
+            frame.bufferIdx = 0;
+            onFrame(frame, descr);
+        }
+        gst_sample_unref(sample);
+    }
+
+    gst_object_unref(appSink);
+    gst_element_set_state(pipeline, GST_STATE_NULL);
+    gst_object_unref(pipeline);
+    return frameNr;
+}
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    if (argc < 2) {
+        std::cerr << "Usage: " << argv[0] << " <png_dir|video_file> [ground_truth_file] [config_file] [png_fps]\n";
+        return 1;
+    }
+    const std::string inputPath = argv[1];
+
+    std::vector<std::pair<uint64_t, uint64_t>> groundTruth;
+    const bool hasGroundTruth = argc > 2;
+    if (hasGroundTruth && !readGroundTruth(argv[2], groundTruth)) {
+        return 1;
+    }
+
+    Config cfg;
+    if (argc > 3) {
+        cfg.insertFromFile(argv[3]);
+    }
+    const double fps = argc > 4 ? std::atof(argv[4]) : 25.0;
+    if (fps <= 0.0) {
+        std::cerr << "Invalid png fps: " << argv[4] << "\n";
+        return 1;
+    }
+
+    MovementAnalyzer analyzer(cfg);
+    std::vector<uint64_t> triggerFrames;
+    analyzer.subscribeOnMovementDetected([&triggerFrames] (uint64_t frameNr, uint32_t, const std::vector<DetectionBox>&, void*) {
+        triggerFrames.push_back(frameNr);
+    });
+
+    StageStats compensation, resize, diff, labeling, notification, total;
+    uint64_t analyzed = 0;
+    uint64_t movementFrames = 0;
+
+    auto onFrame = [&] (const FrameU8& frame, const FrameDescr& descr) {
+        MovementAnalyzer::StageTimes times;
+        bool movement = analyzer.analyzeFrame(frame, descr, &times);
+        movementFrames += movement;
+        if (frame.nr == 0) {
+            return; // base frame
+        }
+        ++analyzed;
+        compensation.add(times.compensation);
+        resize.add(times.resize);
+        diff.add(times.diff);
+        labeling.add(times.labeling);
+        notification.add(times.notification);
+        total.add(times.compensation + times.resize + times.diff + times.labeling + times.notification);
+    };
+
+    uint64_t frames = DirUtils::isDir(inputPath) ? readPngDir(inputPath, fps, onFrame) : readVideo(inputPath, fps, onFrame);
+    if (analyzed == 0) {
+        std::cerr << "Not enough frames to analyze in: " << inputPath << "\n";
+        return 1;
+    }
+
+    auto printStage = [analyzed] (const char* name, const StageStats& stats) {
+        std::cout << name << "avg: " << stats.sum / analyzed * 1000.0 << "[ms] max: " << stats.max * 1000.0 << "[ms]\n";
+    };
+    std::cout << "Frames: " << frames << " analyzed: " << analyzed << " with movement: " << movementFrames << " triggers: " << triggerFrames.size() << "\n";
+    printStage("compensation ", compensation);
+    printStage("resize       ", resize);
+    printStage("diff         ", diff);
+    printStage("labeling     ", labeling);
+    printStage("notification ", notification);
+    printStage("total        ", total);
+
+    if (hasGroundTruth) {
+        auto inRange = [] (uint64_t frameNr, const std::pair<uint64_t, uint64_t>& r) { return frameNr >= r.first && frameNr <= r.second; };
+        uint64_t truePositives = 0;
+        uint64_t falseNegatives = 0;
+        for (const std::pair<uint64_t, uint64_t>& range : groundTruth) {
+            bool hit = std::any_of(triggerFrames.begin(), triggerFrames.end(), [&] (uint64_t frameNr) { return inRange(frameNr, range); });
+            truePositives += hit;
+            falseNegatives += !hit;
+        }
+        uint64_t falsePositives = 0;
+        for (uint64_t frameNr : triggerFrames) {
+            falsePositives += std::none_of(groundTruth.begin(), groundTruth.end(), [&] (const std::pair<uint64_t, uint64_t>& r) { return inRange(frameNr, r); });
+        }
+
+        double precision = truePositives + falsePositives ? static_cast<double>(truePositives) / (truePositives + falsePositives) : 1.0;
+        double recall = truePositives + falseNegatives ? static_cast<double>(truePositives) / (truePositives + falseNegatives) : 1.0;
+        std::cout << "TP: " << truePositives << " FP: " << falsePositives << " FN: " << falseNegatives << "\n"
+                  << "precision: " << precision << " recall: " << recall << "\n";
+    }
+    return 0;
+}
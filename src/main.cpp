@@ -19,7 +19,7 @@
 #include <memory>
 
 #include "VideoGrabber.h"
-#include "Detector.h"
+#include "DetectorPool.h"
 #include "Config.h"
 #include "SlackSubscriber.h"
 
@@ -35,11 +35,12 @@ int main(int argc, char *argv[])
     Config cfg;
     cfg.insertFromFile(configFilePath);
 
-    std::shared_ptr<Detector> yoloDetector = std::shared_ptr<Detector>(
-                new Detector(cfg));
+    // model is loaded in background while cameras and subscribers are set up
+    std::shared_ptr<DetectorPool> detectorPool = std::make_shared<DetectorPool>(cfg);
+    detectorPool->watchFiles(configFilePath); // model can be changed without restart
 
     VideoGrabber videoGrabber(cfg);
-    videoGrabber.getFrameController().setDetector(yoloDetector);
+    videoGrabber.getFrameController().setDetectorPool(detectorPool);
 
     SlackSubscriber slackSub(cfg);
     slackSub.subscribe(videoGrabber.getFrameController());